@@ -3,21 +3,52 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
-#include <sys/shm.h>
+#include <sys/mman.h>
 #include <dirent.h>
-#include <sys/ipc.h>
 #include <string.h>
 #include <semaphore.h>
 #include <signal.h>
 #include <time.h>
+#include <errno.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdarg.h>
 
-#define MAX_PILOT 20   // max number of cars
+#define BENCH_LAYOUT_CARS 20 // number of cars publishing in --bench-layout
 #define MAX_TRACK 22   // max number of tracks
-#define SHM_KEY 0x1234 // uniq key for shared memory
+#define SHM_NAME_PREFIX "/f1manager" // prefix of the shared memory name (pid and start time are added, so each run has its own)
+#define CAR_EVENT_RING_SIZE 8 // slots in the event ring of each car (power of 2)
+#define CACHE_LINE_SIZE 64 // size of a CPU cache line
+#define PROJECTION_CHUNK 64 // seasons claimed at once by a projection worker
+#define PROJECTION_SAMPLE_BITS 7 // bits of random number to draw 1 sample (4 samples per random number)
+#define PROJECTION_SAMPLES (1 << PROJECTION_SAMPLE_BITS) // results of each grid position sampled per sprint/race by the projection (see sampleSession)
+#define PROJECTION_PACE_MILLIS 250 // time gained in each section of the projection by point scored per sprint/race (above the average)
+#define SECTION_BATCH_LANES 8 // cars advanced together by the vector kernel (see advanceSectionBatch)
+#define RADIX_SORT_MIN 64 // below this number of cars, sortCarsByKey does an insertion sort
+#define SCREEN_CELL_SIZE 48 // bytes of a cell of the screen buffer (text and colors)
+#define SCREEN_MAX_COLUMNS 11 // cells in a row of the ranking table (race)
+#define SCREEN_MAX_FRAME_INTERVAL 1000000000LL // the screen manager wakes up at least once per second (nanoseconds)
+#define JOURNAL_BLOCK_SIZE 4096 // the journal is written by blocks of 4 KB, at offsets multiple of 4 KB
+#define JOURNAL_BUFFER_BLOCKS 64 // blocks waiting for the journal writer thread (256 KB), events are dropped when all are full
+#define REPLAY_SEEK_MILLIS 60000 // ← and → move the replay 1 minute of session backward or forward
+
+// Shared memory layout: by default, data written by different processes are put on different cache lines,
+// so a car simulator publishing an event does not invalidate the cache line of another car or of the controller
+// compile with -DCOMPACT_SHM_LAYOUT to pack all the data (smaller but more cache traffic between cores)
+#ifdef COMPACT_SHM_LAYOUT
+#define CACHE_ALIGNED
+#else
+#define CACHE_ALIGNED _Alignas(CACHE_LINE_SIZE)
+#endif
 
 /**
  * This is the formula 1 manager
@@ -30,7 +61,7 @@
  * 		determine next phase (free practice, qualification, sprint or race)
  * # Main
  * - prepare shared memory for inter process communication
- * 		shm between cars and controller (array with seconds.milliseconds, pitstop?, processed?)
+ * 		shm between cars and controller (one ring of section events per car: section time in microseconds, pitstop?)
  * 		shm between controller and screen manager (array with car total time and distance (how many section passed), best time per section,
  * 												current section time, best lap time, pitstopcount, crashed? )
  * - start controller
@@ -52,31 +83,59 @@ enum RacePhase { START_OF_WEEKEND=0, FREE_PRACTICE_1=1, FREE_PRACTICE_2=2, FREE_
 				SPRINT_QUALIFICATION_1=7, SPRINT_QUALIFICATION_2=8, SPRINT_QUALIFICATION_3=9,
 				SPRINT=10, RACE=11, FINISH=99};
 // data type readSharedMemoryData can retrieve
-enum SharedMemoryDataType { CAR_STATS, RUNNING_CARS, CAR_TIME_AND_STATUSES, RACE_OVER, PROCESSED_FLAGS };
+enum SharedMemoryDataType { CAR_STATS, RUNNING_CARS, RACE_OVER };
 
 /* ------------------------------------------
     struct
    ------------------------------------------ */
-// Struct to store time
-typedef struct {
-	int seconds;
-	int milliseconds;
-} CarTime;
-
-// slot for car communication between car simulator and controller
+// time in microseconds (section time, lap time, total time, ...)
+// a single integer: times are compared and added without carry, and ties are broken below the millisecond
+typedef int64_t CarTime;
+#define CAR_TIME_MILLISECOND 1000LL // 1 ms in CarTime
+#define CAR_TIME_SECOND 1000000LL // 1 s in CarTime
+#define CAR_TIME_NONE (999 * CAR_TIME_SECOND + 999 * CAR_TIME_MILLISECOND) // no time yet (999.999, displayed as ---.---)
+
+// event sent by a car simulator to the controller
 // sectionTime = time taken to do 1/3 of a lap
 // carStatus =
 //    WAIT_IN_STAND -> if car wait in the stand during qualification/free practice
 //    RUNNING       -> when on the track (during race or qualification)
 //    PITSTOP       -> during race, if the car did a pit stop during the section run
 //    CRASHED       -> if car had a crash
-// processed = indicates if the controller already treated the data (if not, the car simulator has to wait before sending new data)
+// sessionMillis = session clock (virtual time in ms since the start of the session) when the event was sent
+// sentAt = CLOCK_MONOTONIC time (in nanoseconds) when the car simulator published the event
+// raceOver = the car simulator knew that the race was over when it computed the event (see rebuildCarSimulator)
 typedef struct {
 	CarTime sectionTime;
 	enum CarStatus carStatus;
-	bool processed;
+	int sessionMillis;
+	long long sentAt;
+	bool raceOver;
 } CarTimeAndStatus;
 
+// struct to measure a latency (count, sum and max in nanoseconds)
+typedef struct {
+	long long count;
+	long long totalNanos;
+	long long maxNanos;
+} LatencyStat;
+
+// bounded single-producer/single-consumer queue of events between 1 car simulator and the controller
+// head is only moved by the car simulator, tail is only moved by the controller, so no semaphore is needed
+// the car simulator has (CAR_EVENT_RING_SIZE - (head - tail)) credits: when 0, it waits for the controller
+typedef struct {
+	// written by the car simulator
+	CACHE_ALIGNED atomic_uint head; // next slot written by the car simulator
+	unsigned int maxDepth; // highest number of events waiting in the ring
+	unsigned int creditStalls; // how many times the car simulator had no credit left
+	LatencyStat deadlineLateness; // how late the car simulator woke up after each deadline (jitter)
+	long long driftNanos; // real time - scheduled time when the car simulator stopped
+	// written by the controller
+	CACHE_ALIGNED atomic_uint tail; // next slot read by the controller
+	// written by the car simulator, read by the controller
+	CACHE_ALIGNED CarTimeAndStatus events[CAR_EVENT_RING_SIZE];
+} CarEventRing;
+
 // struct using by controller to store car data, used by ScreenManager and after the session to store the data on disk
 typedef struct {
 	int pilotNumber; // number of the pilot
@@ -90,6 +149,98 @@ typedef struct {
 	bool inStand; // is the car in the stand ?
 } CarStat;
 
+// header of the result files race_nn_pp.bin (see savePhaseResult), followed by recordCount ResultRecords
+#define RESULT_FILE_MAGIC "F1RESULT"
+#define RESULT_FILE_VERSION 1
+typedef struct {
+	char magic[8]; // RESULT_FILE_MAGIC (without the final \0)
+	uint32_t version; // RESULT_FILE_VERSION, a file of another version is refused
+	uint32_t recordSize; // sizeof(ResultRecord)
+	uint32_t recordCount; // number of pilots of the session
+	uint32_t reserved; // 0
+	uint64_t seed; // seed of the session (to replay it with --headless --seed)
+} ResultFileHeader;
+
+// 1 pilot of a result file: record n = position n of the session (times in microseconds)
+typedef struct {
+	int32_t pilotNumber;
+	int32_t reserved; // 0
+	int64_t bestLap;
+	int64_t bestSectionTime[3];
+} ResultRecord;
+
+// columns of the CarStats in shared memory (see CarStatColumns): bit n = the field was changed
+// (the best and current section times have 1 bit per section)
+#define COLUMN_PILOT_NUMBER 0x0001
+#define COLUMN_TOTAL_TIME 0x0002
+#define COLUMN_DISTANCE 0x0004
+#define COLUMN_BEST_SECTION_TIME 0x0008 // << section
+#define COLUMN_CURRENT_SECTION_TIME 0x0040 // << section
+#define COLUMN_BEST_LAP 0x0200
+#define COLUMN_PIT_STOP_COUNT 0x0400
+#define COLUMN_CRASHED 0x0800
+#define COLUMN_IN_STAND 0x1000
+#define COLUMN_ALL 0x1fff
+
+// CarStats of the session in shared memory, stored by column: 1 array of pilotCount elements per field of CarStat
+// (each array starts on its own cache line), so the controller only writes the fields changed by an event
+// a CarStat is read with getCarStat and written with putCarStat
+typedef struct {
+	int* pilotNumber;
+	CarTime* totalTime;
+	int* distance;
+	CarTime* bestSectionTime[3];
+	CarTime* currentSectionTime[3];
+	CarTime* bestLap;
+	int* pitStopCount;
+	bool* crashed;
+	bool* inStand;
+} CarStatColumns;
+
+// 1 cell of the ranking table (the text between 2 │, with its colors)
+typedef struct {
+	char text[SCREEN_CELL_SIZE];
+} ScreenCell;
+
+// everything displayed in a row of the ranking table: when it did not change, the cells of the row are not formatted again
+// (compared with memcmp: always memset to 0 before setting the fields)
+typedef struct {
+	int pilotNumber;
+	int distance;
+	CarTime totalTime;
+	CarTime bestLap;
+	CarTime bestSectionTime[3];
+	int pitStopCount;
+	bool crashed;
+	bool inStand;
+	const char* positionUpdate; // =, ↑ or ↓
+	char difference[9]; // with the previous car
+	char difference1st[9]; // with the 1st car
+	unsigned int highlights; // bit 0 = best lap, bit 1 to 3 = best sections
+} ScreenRowSource;
+
+// frames of the ranking table drawn by the screen manager (see drawScreenFrame)
+// the last frame drawn is kept, so only the cells that changed are sent to the terminal, with 1 write()
+typedef struct {
+	int rows; // rows of cars in the table
+	int columns; // cells in a row
+	int left; // terminal column of the 1st │
+	const int* widths; // number of characters displayed in each cell
+	ScreenCell* cells; // frame being built (rows x columns)
+	ScreenCell* previous; // frame on the screen
+	ScreenRowSource* sources; // data of each row of the frame on the screen
+	bool redraw; // the table has to be drawn completely (1st frame, new size of the terminal)
+	char* output; // escape sequences and text of the changed cells
+	size_t outputLength;
+	size_t outputSize;
+	// work arrays of displayData (1 element per car), allocated with the 1st frame
+	CarStat* sorted;
+	const char** positionUpdates;
+	char (*differences)[9];
+	char (*differences1st)[9];
+	bool* crashed;
+} ScreenBuffer;
+
 // struct to store score after race or sprint
 typedef struct {
 	int pilotNumber;
@@ -98,18 +249,329 @@ typedef struct {
 	int raceWon;
 } PilotStat;
 
-// shared struct for process communication (SHARED MEMORY)
+// standings.bin: points of the championship, updated by saveChampionshipResult after each sprint/race (see loadFinalChampionshipResult)
+// round = 1 sprint or race of the championship: 2*race for the sprint, 2*race+1 for the race (see getStandingsRound)
+#define STANDINGS_FILE_MAGIC "F1STANDS"
+#define STANDINGS_FILE_VERSION 1
 typedef struct {
-	CarTimeAndStatus carTimeAndStatuses[MAX_PILOT];  // we allocate 20 slots for the car to send data to controller
-	CarStat carStats[MAX_PILOT]; // 20 slots for all pilot data
-	int runningCars; // amount of still running car (when 0 = no car running anymore, all race/qualif ended)
-	bool raceOver; // indicate if a pilot reach finish line (all other car must finish their lap and stop)
+	char magic[8]; // STANDINGS_FILE_MAGIC (without the final \0)
+	uint32_t version; // STANDINGS_FILE_VERSION, a file of another version is rebuilt
+	uint32_t recordSize; // sizeof(StandingsRecord)
+	uint32_t recordCount; // number of pilots (1 record per line of drivers.csv, same order)
+	uint32_t reserved; // 0
+	uint64_t appliedRounds; // bit n = the ranking file of round n is counted in the records
+} StandingsFileHeader;
+
+// standings of 1 pilot
+typedef struct {
+	int32_t pilotNumber;
+	int32_t score; // points of all the applied rounds
+	int32_t raceWon; // sprints and races won
+	int32_t reserved; // 0
+	uint64_t roundsWon; // bit n = round n won
+	int16_t roundPoints[MAX_TRACK * 2]; // points scored in each round (to replace a round saved again)
+} StandingsRecord;
+
+// race_nn_pp.journal: every event processed in a session (see journalEvent)
+// header, pilot number of each car (int32), then the records from offset headerSize
+#define JOURNAL_FILE_MAGIC "F1JOURNL"
+#define JOURNAL_FILE_VERSION 1
+typedef struct {
+	char magic[8]; // JOURNAL_FILE_MAGIC (without the final \0)
+	uint32_t version; // JOURNAL_FILE_VERSION
+	uint32_t recordSize; // sizeof(JournalRecord)
+	uint32_t headerSize; // offset of the 1st record (multiple of JOURNAL_BLOCK_SIZE)
+	uint32_t carCount; // number of cars running in the session
+	int32_t race; // race number (0 = 1st race)
+	int32_t phase; // enum RacePhase
+	int32_t maxLap; // laps of the sprint/race
+	uint32_t reserved; // 0
+	uint64_t seed; // seed of the session
+	uint64_t recordCount; // written when the journal is closed (0 if the session was interrupted: the size of the file gives the count)
+	uint64_t droppedCount; // events not saved because the writer thread was late
+} JournalFileHeader;
+
+// 1 event of the journal
+typedef struct {
+	int64_t sectionTime; // CarTime of the section
+	int32_t sessionMillis; // session clock when the car sent the event
+	uint16_t car; // index of the car (its pilot number follows the header)
+	uint8_t section; // section of the lap (0..2) run by the car when it sent the event
+	uint8_t carStatus; // enum CarStatus: the pit stops and crashes are statuses of the event
+} JournalRecord;
+#define JOURNAL_BLOCK_RECORDS (JOURNAL_BLOCK_SIZE / (int)sizeof(JournalRecord))
 
-	sem_t mutex; // semaphore for writers (exclusive access: only 1 writer as access)
+// shared struct for process communication (SHARED MEMORY)
+// fields are grouped by writer (see CACHE_ALIGNED)
+typedef struct {
+	// arrays of pilotCount elements, allocated after this struct in the same mapping (see createSharedMemory)
+	// the mapping is created before the fork of the childs, so these addresses are the same in all processes
+	CarEventRing* carEventRings; // 1 ring per car to send data to controller, written by the car simulators (each ring is on its own cache lines)
+	CarStatColumns carStats; // 1 slot per pilot in each column, written by the controller (protected by carStatsSequence)
+	int* ranking; // running order: ranking[position] = index in carStats, written by the controller (protected by carStatsSequence)
+
+	// written by the controller
+	CACHE_ALIGNED atomic_uint carStatsSequence; // sequence lock of carStats: odd while the controller is writing, readers retry
+	long long controllerWakeups; // how many times the controller has been woken up
+	LatencyStat eventLatency; // time between an event being published and read by the controller
+	LatencyStat carStatCommit; // time spent by the controller in commitControllerUpdates
+	long long committedCarStats; // how many CarStat records were published by all commits
+	long long committedBytes; // bytes of carStats and ranking written by all commits
+	long long journalEvents; // events saved in the journal
+	long long journalDropped; // events not saved (journal writer too late)
+	long long journalWrites; // blocks written by the journal writer thread
+	long long checkpoints; // checkpoints written by the journal writer thread
+	long long checkpointNanos; // time spent to write them
+	atomic_uint carStatsGeneration; // incremented by each commit, the screen manager redraws when it changed (see screenManager)
+	atomic_bool controllerDone; // the controller processed the last event of the session
+	atomic_bool raceOver; // indicate if a pilot reach finish line (all other car must finish their lap and stop), read by each car at each section
+
+	// control words (Courtois algorithm), written by everybody
+	CACHE_ALIGNED sem_t mutex; // semaphore for writers (exclusive access: only 1 writer as access)
 	sem_t mutread; // semaphore for readers (shared access: as many readers as needed)
 	int readerCount; // count how many reader we have
+	int runningCars; // amount of still running car (when 0 = no car running anymore, all race/qualif ended)
+	long long sessionStart; // CLOCK_MONOTONIC time (in nanoseconds) of the virtual time 0 of the session, set before the launch of the car simulators
+
+	// written by the screen manager
+	CACHE_ALIGNED long long screenFrames; // frames drawn
+	long long screenSkippedFrames; // refreshes without any change (nothing drawn)
+	long long screenBytes; // bytes written to the terminal
+	long long screenCpuNanos; // CPU time used by the screen manager
+	long long screenWakeups; // how many times the screen manager has been woken up
+
+	// posted by all car simulators, waited by the controller
+	CACHE_ALIGNED sem_t dataReady; // posted each time a car simulator publishes an event or stops (wakes up the controller)
+	// posted by the controller, waited by the screen manager
+	sem_t screenWakeup; // posted after each commit and when the controller stops
 } SharedMemory;
 
+// xoshiro128** random generator: each car has its own stream in each session (see rngSeed),
+// so a session can be replayed with its seed and the simulators do not share any state
+typedef struct {
+	uint32_t s[4];
+} Rng;
+
+// cars of one or many grids, advanced 1 section at a time by advanceSectionBatch (structure of arrays:
+// 1 array per field, so SECTION_BATCH_LANES cars are loaded in 1 vector), see startSectionBatch
+// times are in milliseconds, each array has count elements (count is a multiple of SECTION_BATCH_LANES)
+typedef struct {
+	int count; // number of lanes (the last ones may be unused, they are never running)
+	int32_t* sectionMillis; // time of the next section
+	int32_t* totalMillis; // time of all the sections done
+	int32_t* section; // sections done (lap = section/3)
+	int32_t* pitStopLap[3]; // laps with a pit stop (9999 = no pit stop)
+	int32_t* running; // -1 = running, 0 = stopped (finished or crashed), used as a mask
+	int32_t* crashed; // -1 = crashed
+	int32_t* paceMillis; // time added to each section done (negative = faster car)
+	uint32_t* rng[4]; // xoshiro128** state of each car
+} SectionBatch;
+
+// vectors of SECTION_BATCH_LANES lanes (GCC vector extensions, compiled to SSE/AVX/NEON when available)
+typedef uint32_t VecU32 __attribute__((vector_size(SECTION_BATCH_LANES * sizeof(uint32_t))));
+typedef int32_t VecI32 __attribute__((vector_size(SECTION_BATCH_LANES * sizeof(int32_t))));
+typedef uint64_t VecU64 __attribute__((vector_size(SECTION_BATCH_LANES * sizeof(uint64_t))));
+
+// state of a car simulator between 2 events (see carSimulatorNext)
+enum CarSimulatorStep { RACE_SECTION, QUALIFICATION_IN_STAND, QUALIFICATION_LAP, QUALIFICATION_SECTION, QUALIFICATION_BACK_TO_STAND, CAR_SIMULATOR_DONE };
+
+// everything a car simulator needs to compute its next event
+// (the car simulator is a state machine, so 1 thread can drive many cars: see runDiscreteEventSession)
+typedef struct {
+	enum CarSimulatorStep step; // what the car will do at its next event
+	CarTime sectionTime; // time of the current section
+	int section; // race: sections done since the start (lap = section/3), qualification: section in the current lap (0..2)
+	// race or sprint
+	int maxLap; // how many lap to to end the race
+	int pitStopLap[3]; // laps with a pit stop (9999 = no pit stop)
+	bool running; // false when the car stops after this section (race over or crashed)
+	// free practice or qualification
+	int maxTime; // how many time (ms) the car may try to run
+	int sessionTime; // time (ms) already used in the session
+	Rng rng; // random numbers of the car in this session
+} CarSimulatorState;
+
+// race_nn_pp.checkpoint: state of a session being run, to continue it after a crash (--resume)
+// the header is followed by the data placed by layoutCheckpoint (CarStats and CarSimulatorStates as in memory:
+// a checkpoint is only read by the same build of the program)
+#define CHECKPOINT_FILE_MAGIC "F1CHKPNT"
+#define CHECKPOINT_FILE_VERSION 2
+typedef struct {
+	char magic[8]; // CHECKPOINT_FILE_MAGIC (without the final \0)
+	uint32_t version; // CHECKPOINT_FILE_VERSION
+	uint32_t size; // size of the file (see layoutCheckpoint)
+	uint32_t carStatSize; // sizeof(CarStat)
+	uint32_t carStateSize; // sizeof(CarSimulatorState)
+	int32_t carCount; // number of CarStats (pilotCount)
+	int32_t pilotRunning; // number of car simulators
+	int32_t race; // race number (0 = 1st race)
+	int32_t phase; // enum RacePhase
+	uint64_t seed; // seed of the session
+	int32_t raceOver; // a car reached the finish line
+	int32_t sessionMillis; // session clock of the last event folded
+	uint64_t journalRecords; // events in the journal (the last partialRecords are saved in the checkpoint)
+	uint64_t journalDropped; // events dropped by the journal
+	int32_t partialRecords; // records of the block of the journal being filled
+	int32_t sequence; // checkpoints taken in the session
+} CheckpointHeader;
+
+// 1 car simulator in a checkpoint
+typedef struct {
+	long long events; // events folded by the controller
+	long long virtualMillis; // session clock of the next event of the car
+	CarSimulatorState state; // state of the car simulator after its last event folded (rebuilt from the seed, see rebuildCarSimulator)
+	bool sawRaceOver; // the last event folded was computed after the end of the race
+} CheckpointCar;
+
+// parts of a checkpoint (see layoutCheckpoint)
+typedef struct {
+	CheckpointHeader* header;
+	CarStat* carStats; // carCount CarStats of the controller
+	int* ranking; // carCount positions (running order of the controller)
+	CheckpointCar* cars; // pilotRunning car simulators
+	JournalRecord* journal; // records of the block of the journal being filled
+} Checkpoint;
+
+// journal of the session being run, only used by the process (or thread) folding the events
+// the controller fills the blocks, a background thread writes the full blocks: the controller never waits for the disk
+typedef struct {
+	int fd;
+	JournalFileHeader header;
+	JournalRecord* blocks; // JOURNAL_BUFFER_BLOCKS blocks of JOURNAL_BLOCK_RECORDS records (aligned on JOURNAL_BLOCK_SIZE)
+	int used; // records in the block being filled (not yet given to the writer)
+	atomic_uint filled; // blocks given to the writer, only written by the controller
+	atomic_uint written; // blocks written on disk, only written by the writer thread
+	atomic_bool closing; // the session is over, the writer thread stops when all blocks are written
+	atomic_int error; // errno of the write that failed in the writer thread (0 = none): the journal is stopped, reported by closeJournal
+	sem_t blockReady; // posted by the controller when a block is full and at the end of the session
+	pthread_t writer;
+	long long writes; // blocks written by the writer thread
+	// checkpoints of the session (see takeCheckpoint), also written by the writer thread
+	char* checkpoint; // snapshot filled by the controller (allocated at the 1st checkpoint)
+	size_t checkpointSize;
+	atomic_bool checkpointPending; // the snapshot is waiting for the writer thread
+	long long checkpoints; // checkpoints written
+	long long checkpointNanos; // time spent by the writer thread to write them
+	CheckpointCar* shadows; // copy of each car simulator, advanced by the writer thread to the events of each checkpoint
+} Journal;
+
+// a recorded session folded again from its journal (see openReplay), without car simulator nor shared memory
+// the cars are in the order of the journal, then the pilots that were not running (in stand)
+typedef struct {
+	const JournalFileHeader* header; // journal mapped in memory
+	size_t size;
+	const JournalRecord* records;
+	long long recordCount;
+	long long next; // next record to fold
+	int clock; // session clock (ms) of the folded records
+	int duration; // session clock of the last record
+	int carCount; // cars running in the session
+	bool race;
+	CarStat* carStats; // pilotCount cars, folded like the controller
+	int* ranking; // running order (updated 1 car at a time, see moveCarInRanking)
+	int* position;
+	uint64_t* keys;
+} Replay;
+
+// a car waiting for its next event in the discrete event engine
+// time = virtual time (ms since the start of the session) of the next event
+typedef struct {
+	long long time;
+	int car;
+} ScheduledCar;
+
+// priority queue (binary min heap on time, then car) of the discrete event engine
+typedef struct {
+	ScheduledCar* items;
+	int count;
+} CarSchedule;
+
+// 1 event of a session run by the self test (see runSelfTestSession)
+typedef struct {
+	int car;
+	CarTimeAndStatus event;
+} SelfTestEvent;
+
+// command line options (see parseOptions)
+typedef struct {
+	bool benchLayout; // --bench-layout: run the shared memory layout benchmark and quit
+	bool threads; // --threads: run controller, car simulators and screen manager as threads of 1 process
+	int stressCars; // --stress N: run a race with N cars in the discrete event engine and quit (0 = no stress test)
+	int benchSectionCars; // --bench-sections N: compare the vector and scalar section kernels with N cars and quit (0 = no benchmark)
+	bool benchSort; // --bench-sort: compare qsort and the sort keys (radix sort) with 20, 1k and 100k cars and quit
+	bool selfTest; // --self-test: check the sort keys, the vector section kernel and the resume of a session, and quit (exit code 1 if a check fails)
+	bool noCsv; // --no-csv: save the result of the sessions only in race_nn_pp.bin (no race_nn_pp.csv)
+	bool exportCsv; // --export-csv: write race_nn_pp.csv from every race_nn_pp.bin and quit
+	bool rebuildStandings; // --rebuild-standings: rebuild standings.bin from the ranking files and quit
+	bool noJournal; // --no-journal: do not save the events of the sessions in race_nn_pp.journal
+	const char* analyzeJournal; // --journal FILE: display the analysis of a journal and quit (NULL = no analysis)
+	int checkpointSeconds; // --checkpoint N: seconds between 2 checkpoints of the session (5 by default, 0 = no checkpoint)
+	bool resume; // --resume: continue the next session from its checkpoint
+	const char* replay; // --replay FILE: display the session recorded in a journal again (NULL = no replay)
+	int replaySeekSeconds; // --seek N: session clock where the replay starts (seconds)
+	bool scanJournals; // --scan: fold every journal of the championship again, check them with the results and quit
+	int fps; // --fps N: refresh rate of the screen manager (1 to 30 frames per second, 1 by default)
+	int q2Cut; // --q2-cut N: number of pilots running Q2/SQ2 (3/4 of the grid by default)
+	int q3Cut; // --q3-cut N: number of pilots running Q3/SQ3 (1/2 of the grid by default)
+	int speed; // --speed N: time compression factor of the car simulators (1 = real time, 60 by default, max 1000)
+	bool headless; // --headless: simulate the sessions in the discrete event engine, without waiting and without screen
+	int sessions; // --sessions N: number of sessions simulated by --headless (0 = until the end of the championship)
+	uint64_t seed; // --seed N: seed of the next session (random by default), the following sessions derive their seed from it
+	int projectionSeasons; // --projection N: simulate N times the rest of the championship and display the probabilities (0 = no projection)
+} Options;
+
+// the 3 types of worker started by main
+enum WorkerType { CONTROLLER_WORKER, CAR_SIMULATOR_WORKER, SCREEN_MANAGER_WORKER };
+
+// arguments of a worker (a child process or a thread, see launchWorker)
+typedef struct {
+	enum WorkerType type;
+	int id; // car number (car simulator only)
+	CarTime delay; // delay on the starting grid (car simulator only)
+	int raceNumber;
+	enum RacePhase phase;
+	int pilotRunning;
+	uint64_t seed; // seed of the session (car simulator only)
+	pid_t pid; // child process of the worker (set by launchWorker, not with --threads)
+} WorkerArgs;
+
+// seasons of 1 projection worker: the owner claims PROJECTION_CHUNK seasons at a time from next,
+// when its range is empty it steals chunks from the ranges of the other workers (same fetch_add on their next)
+typedef struct {
+	CACHE_ALIGNED atomic_int next; // next season not yet claimed
+	int end; // end of the range (excluded)
+} ProjectionRange;
+
+// sprint or race still to run in the championship
+typedef struct {
+	enum RacePhase phase;
+	int maxLap;
+	// finishing key of PROJECTION_SAMPLES x pilotCount cars without pace (index = sample * pilotCount + grid position):
+	// total time (ms) of a car that finished, (1 << 32) | (INT32_MAX - sections) of a crashed car
+	uint64_t* samples;
+} ProjectedSession;
+
+// data of 1 projection worker (a thread)
+typedef struct {
+	int id;
+	int workerCount;
+	ProjectionRange* ranges; // ranges of all the workers
+	const PilotStat* standings; // current standings, sorted
+	const int32_t* paces; // paceMillis of each pilot of standings (see projectChampionship)
+	ProjectedSession* sessions; // samples of the session s filled by the worker s % workerCount
+	int sessionCount;
+	pthread_barrier_t* sampled; // all the workers wait until all the sessions are sampled
+	uint64_t sampleSeed; // seed of the samples, each session has its own streams
+	uint64_t seed; // seed of the projection, each season has its own stream
+	// work data of simulateSeasons (allocated by the worker)
+	int* score; // pilotCount, points of 1 season
+	int* raceWon; // pilotCount
+	uint64_t* top; // 10 first cars of 1 grid (finishing key << 31 | car), see simulateSeasons
+	long long* positionCounts; // pilotCount x pilotCount: positionCounts[pilot*pilotCount+position] = number of seasons ended at this position
+	long long seasons; // number of seasons simulated by this worker
+	long long stolenSeasons; // number of seasons stolen from the other workers
+} ProjectionWorker;
+
 // Driver's data (data from drivers.csv)
 typedef struct {
 	int id;
@@ -128,11 +590,17 @@ typedef struct {
 // ------------------------------------------
 //  Global variables
 // ------------------------------------------
-DriverData drivers[MAX_PILOT];
+DriverData* drivers = NULL; // pilots read from drivers.csv
+Checkpoint resumeCheckpoint; // checkpoint loaded by --resume (header NULL = new session), inherited by the workers
+int pilotCount = 0; // number of pilots (lines of drivers.csv), size of the grid
 TrackData tracks[MAX_TRACK];
+Options options;
 
 // Pointer to shared memory
 SharedMemory *sharedMemory = NULL;
+char sharedMemoryName[64] = ""; // name of the POSIX shared memory of this run (inherited by the childs)
+size_t sharedMemorySize = 0; // size of the mapping
+pid_t sharedMemoryOwner = 0; // process that created the shared memory (only this one destroys it)
 
 // ------------------------------------------
 //  Functions
@@ -141,10 +609,9 @@ SharedMemory *sharedMemory = NULL;
  * CarTime functions
 */
 int compareCarTime(CarTime t1, CarTime t2);
+CarTime parseCarTime(const char* field);
 int compareCarStatRace(const void * elem1, const void * elem2);
 int compareCarStatQualification(const void * elem1, const void * elem2);
-void subCarTime(CarTime *diff, const CarTime t1, const CarTime t2);
-void combineCarTime(CarTime *t1, const CarTime t2);
 void carTime2String(char* carTimeAsString, CarTime carTime, int digitCount);
 void carTime2HMS(char* carTimeAsString, CarTime carTime);
 
@@ -152,6 +619,9 @@ void carTime2HMS(char* carTimeAsString, CarTime carTime);
  * General purpose functions
 */
 int millisWait(int millis);
+void deadlineWait(long long deadline);
+long long getMonotonicNanos();
+void addLatency(LatencyStat* latencyStat, long long nanos);
 char getConfirmation();
 const char* racePhaseToShortString(enum RacePhase phase);
 char* getDriverName(int id);
@@ -164,102 +634,258 @@ int comparePilotStat(const void * elem1, const void * elem2);
 /**
  * File access functions
 */
-void readDriverData(DriverData* drivers);
+DriverData* readDriverData(int* driverCount);
 void readTrackData(TrackData* tracks);
-void savePhaseResult(int race, enum RacePhase phase, int pilotRunning);
+void savePhaseResult(int race, enum RacePhase phase, uint64_t seed);
+void writeResultCsv(const char* filename, const ResultRecord* records, int recordCount, uint64_t seed);
+const ResultFileHeader* mapResultFile(int race, enum RacePhase phase, size_t* size);
 void loadPhaseResult(CarStat* carStats, int race, enum RacePhase phase);
+void loadPhaseResultCsv(CarStat* carStats, int race, enum RacePhase phase);
+void exportResultCsv();
 void saveChampionshipResult(int race, enum RacePhase phase);
-void loadFinalChampionshipResult(int raceNumber, PilotStat* pilotStats, DriverData* drivers);
+int loadFinalChampionshipResult(int raceNumber, PilotStat* pilotStats, DriverData* drivers);
+int getStandingsRound(int race, enum RacePhase phase);
+int findDriver(int pilotNumber);
+void initStandings(StandingsFileHeader* header, StandingsRecord* records);
+bool readStandings(StandingsFileHeader* header, StandingsRecord* records);
+void writeStandings(const StandingsFileHeader* header, const StandingsRecord* records);
+void applyRoundToStandings(StandingsFileHeader* header, StandingsRecord* records, int round, const int* pilotNumbers, const int* points, int count);
+void rebuildStandings(int lastRound, StandingsFileHeader* header, StandingsRecord* records);
 
 /**
  * Screen Manager functions
 */
 void getDifferences(char (*differences)[9], CarStat* sorted, bool compareWithFirst, int pilotRunning);
-void displayData(const CarStat* carStats, const CarStat* carStatsPrevious, bool race, int pilotRunning);
+void displayData(ScreenBuffer* screen, const CarStat* carStats, const int* ranking, const int* previousPosition, bool race, int pilotRunning);
 void screenManager(enum RacePhase phase, int pilotRunning);
+void initScreenBuffer(ScreenBuffer* screen);
+void freeScreenBuffer(ScreenBuffer* screen);
+void resizeScreenBuffer(ScreenBuffer* screen, int rows, int columns, int left, const int* widths);
+bool reuseScreenRow(ScreenBuffer* screen, int row, const ScreenRowSource* source);
+void setScreenCell(ScreenBuffer* screen, int row, int column, const char* format, ...);
+void appendScreenOutput(ScreenBuffer* screen, const char* format, ...);
+void drawScreenFrame(ScreenBuffer* screen, const char* const* borders);
 void displayLogo();
 char* getDriverShortName(int id);
 
 /**
  * Controller functions
 */
-void controller(int trackNumber,int phase, int pilotRunning);
+void controller(int trackNumber,int phase, int pilotRunning, uint64_t seed);
+bool foldCarEvent(CarStat* carStat, const CarTimeAndStatus* carTimeAndStatus, enum RacePhase phase, int maxLap);
+void initCarStatTimes(CarStat* carStat);
+void initRanking(int* ranking, int* position, int carCount);
+int moveCarInRanking(int* ranking, int* position, const uint64_t* keys, int car, int carCount);
+
+/**
+ * Sort keys (order of the cars without comparator)
+*/
+uint64_t getCarSortKey(const CarStat* carStat, bool race);
+void sortCarsByKey(const uint64_t* keys, int* ranking, int carCount);
+void rankCars(const CarStat* carStats, int* ranking, int carCount, bool race);
+void fillRandomCarStats(CarStat* carStats, int carCount, Rng* rng);
+bool sameCarOrder(const CarStat* sorted, const CarStat* carStats, const int* ranking, int carCount, bool race);
+bool benchmarkCarSort();
 
 /**
  * Car simulator functions
 */
-void carSimulator(int id, CarTime delay, int trackNumber,enum RacePhase phase);
-void carSimulatorRace(int id, CarTime delay, int maxLap);
-void carSimulatorQualification(int id, int maxTime);
+void carSimulator(int id, CarTime delay, int trackNumber,enum RacePhase phase, uint64_t seed);
+void initCarSimulator(CarSimulatorState* state, int id, CarTime delay, int trackNumber, enum RacePhase phase, uint64_t seed);
+bool carSimulatorNext(CarSimulatorState* state, bool raceOver, CarTimeAndStatus* carTimeStatus, int* waitMillis);
+bool carSimulatorRaceNext(CarSimulatorState* state, bool raceOver, CarTimeAndStatus* carTimeStatus, int* waitMillis);
+bool carSimulatorQualificationNext(CarSimulatorState* state, CarTimeAndStatus* carTimeStatus, int* waitMillis);
+
+/**
+ * Discrete event engine functions
+*/
+void scheduleCar(CarSchedule* schedule, long long time, int car);
+bool nextScheduledCar(CarSchedule* schedule, ScheduledCar* next);
+long long runDiscreteEventSession(CarSimulatorState* cars, CarStat* carStats, int* ranking, int carCount, enum RacePhase phase, int maxLap, long long* virtualTime, Journal* journal);
+void stressTest(int carCount);
+
+/**
+ * Event journal (race_nn_pp.journal)
+*/
+Journal* openJournal(int race, enum RacePhase phase, int maxLap, const CarStat* carStats, int carCount, uint64_t seed, const Checkpoint* resume);
+void journalEvent(Journal* journal, int car, int section, const CarTimeAndStatus* carTimeAndStatus);
+void* journalWriter(void* arg);
+void closeJournal(Journal* journal);
+const JournalFileHeader* mapJournal(const char* filename, size_t* size);
+const int32_t* getJournalPilots(const JournalFileHeader* header);
+const JournalRecord* getJournalRecords(const JournalFileHeader* header);
+long long getJournalRecordCount(const JournalFileHeader* header, size_t size);
+void analyzeJournal(const char* filename);
+
+/**
+ * Checkpoints (race_nn_pp.checkpoint)
+*/
+size_t layoutCheckpoint(Checkpoint* checkpoint, char* base, int carCount, int pilotRunning);
+void takeCheckpoint(Journal* journal, const CarStat* carStats, const int* ranking, const long long* events, const bool* sawRaceOver, bool raceOver, int sessionMillis);
+bool writeCheckpoint(Journal* journal);
+void rebuildCarSimulator(CheckpointCar* car, long long events, bool sawRaceOver);
+bool loadCheckpoint(int race, enum RacePhase phase, Checkpoint* checkpoint);
+void removeCheckpoint(int race, enum RacePhase phase);
+
+/**
+ * Replay of the journals
+*/
+bool openReplay(Replay* replay, const char* filename);
+void resetReplay(Replay* replay);
+void replayUntil(Replay* replay, int sessionMillis);
+void seekReplay(Replay* replay, int sessionMillis);
+void closeReplay(Replay* replay);
+int readReplayKey(int timeoutMillis);
+void runReplay(const char* filename);
+int scanJournals();
+
+/**
+ * Random numbers
+*/
+uint64_t splitMix64(uint64_t* x);
+void rngSeed(Rng* rng, uint64_t seed, uint64_t stream);
+uint32_t rngNext(Rng* rng);
+int rngInt(Rng* rng, int n);
+uint64_t nextSessionSeed();
+
+/**
+ * Section batch kernel (vectorized race sections)
+*/
+SectionBatch* createSectionBatch(int carCount);
+void startSectionBatch(SectionBatch* batch, int carCount, int gridSize, const int32_t* gridPaces, int maxLap, uint64_t seed, uint64_t firstStream, bool gridStreams);
+void freeSectionBatch(SectionBatch* batch);
+int batchRandom(uint32_t random, int n);
+void advanceSectionScalar(SectionBatch* batch, int maxLap, int crashOdds);
+void advanceSectionBatch(SectionBatch* batch, int maxLap, int crashOdds);
+void vecRngNext(VecU32* s, VecU32* result);
+bool sameSectionBatch(const SectionBatch* a, const SectionBatch* b);
+bool benchmarkSectionKernel(int carCount);
+
+/**
+ * Championship projection (Monte Carlo)
+*/
+int claimSeasons(ProjectionRange* range, int* first);
+void sampleSession(SectionBatch* batch, ProjectedSession* session, uint64_t seed, uint64_t firstStream);
+void simulateSeasons(ProjectionWorker* worker, int first, int count);
+void* projectionWorker(void* arg);
+void projectChampionship(int seasonCount);
+
+/**
+ * Self test (--self-test)
+*/
+bool selfTestCarSort(Rng* rng);
+bool selfTestSectionKernel(Rng* rng, uint64_t seed);
+long long runSelfTestSession(CarSimulatorState* cars, CarStat* carStats, int carCount, enum RacePhase phase, int maxLap, const long long* startMillis, bool raceOver, SelfTestEvent** events);
+bool selfTestResume(int carCount, enum RacePhase phase, uint64_t seed);
+bool selfTest();
 
 /**
  * Shared Memory Functions (implementing "Courtois" algorithm)
 */
+void createSharedMemory();
+void createNamedSharedMemory();
 void cleanupSharedMemory(int signum);
+void releaseSharedMemory();
 void readSharedMemoryData(void* data, enum SharedMemoryDataType smdt);
+unsigned int readCarStats(CarStat* carStats, int* ranking);
+char* placeColumn(char* base, size_t* offset, size_t size);
+size_t layoutCarStatColumns(CarStatColumns* columns, char* base, int count);
+void getCarStat(int car, CarStat* carStat);
+int putCarStat(int car, const CarStat* carStat, unsigned int columns);
+unsigned int getChangedColumns(const CarStat* before, const CarStat* after);
 int getRunningCars();
 bool isRaceOver();
 void decrementRunningCars();
 void setRaceAsOver();
-void setCarTimeAndStatusAsProcessed(int i);
-void updateCarStat(CarStat carStat, int i);
-int sendDataToController(int id, CarTimeAndStatus status);
+void commitControllerUpdates(const CarStat* carStats, const int* ranking, int rankingFirst, int rankingLast, const unsigned int* dirtyColumns, const int* consumed, int pilotRunning, bool raceOver);
+void sendDataToController(int id, CarTimeAndStatus status);
+bool receiveDataFromCar(int id, int index, CarTimeAndStatus* status);
+int getCarEventQueueDepth(int id);
+
+/**
+ * Benchmark functions
+*/
+void benchmarkSharedMemoryLayout(int iterations);
 
 /**
  * main functions
 */
+void parseOptions(int argc, char *argv[]);
 const char* racePhaseToString(enum RacePhase phase);
 enum RacePhase getNextPhase(enum RacePhase currentPhase, bool special);
 enum RacePhase getPreviousPhase(enum RacePhase currentPhase, bool special);
-void displayRanking(int raceNumber);
+void loadChampionshipState(int* raceNumber, enum RacePhase* phase);
+bool getNextSession(int* raceNumber, enum RacePhase* phase);
+void saveChampionshipState(int raceNumber, enum RacePhase phase);
+void initSessionData(int raceNumber, enum RacePhase phase, int pilotRunning);
+void saveSessionResult(int raceNumber, enum RacePhase phase, uint64_t seed);
+void runHeadless();
+int getTerminalRows();
+int displayRanking(int raceNumber);
+void displaySessionReport(int row, int pilotRunning, long long startupNanos, long peakRssKb, uint64_t seed);
+void runWorker(const WorkerArgs* args);
+void* workerThread(void* args);
+bool launchWorker(WorkerArgs* args, pthread_t* thread);
+void stopWorkers(WorkerArgs* workers, pthread_t* threads, int workerCount);
 
 // ------------------------------------------
 //  Functions definitions
 // ------------------------------------------
-// function to compare 2 car times
+// function to compare 2 car times (-1 if t1 is smaller, 0 if equal, 1 if t1 is bigger)
 int compareCarTime(CarTime t1, CarTime t2) {
-	// compare seconds
-	if (t1.seconds < t2.seconds) {
-		return -1;  // t1 is smaller
-	} else if (t1.seconds > t2.seconds) {
-		return 1;   // t1 is bigger
-	}
+	return (t1 > t2) - (t1 < t2);
+}
 
-	// Seconds are equals, so compare milliseconds
-	return t1.milliseconds - t2.milliseconds;
+// read a time of a result file (seconds.fraction)
+// 6 digits fraction = microseconds (current format), otherwise the fraction is a number of milliseconds
+// (old format written with %d.%d: 25.45 is 25 seconds and 45 milliseconds)
+CarTime parseCarTime(const char* field) {
+	char* end;
+	long long seconds = strtoll(field, &end, 10);
+	CarTime carTime = seconds * CAR_TIME_SECOND;
+	if (*end == '.') {
+		const char* fraction = end + 1;
+		long long value = strtoll(fraction, &end, 10);
+		if (end - fraction == 6) {
+			carTime += value;
+		} else {
+			carTime += value * CAR_TIME_MILLISECOND;
+		}
+	}
+	return carTime;
 }
 
 // function to compare 2 car records
 // will be used to order the car, not crashed car first, then biggest distance and finally totalTime
 int compareCarStatRace(const void * elem1, const void * elem2) {
-	CarStat cr1 = (CarStat)*(CarStat*)elem1;
-	CarStat cr2 = (CarStat)*(CarStat*)elem2;
+	const CarStat* cr1 = (const CarStat*)elem1;
+	const CarStat* cr2 = (const CarStat*)elem2;
 
 	// not crashed car comes first
-	if (!cr1.crashed && cr2.crashed) {
+	if (!cr1->crashed && cr2->crashed) {
 		return -1;
-	} else if (cr1.crashed && !cr2.crashed) {
+	} else if (cr1->crashed && !cr2->crashed) {
 		return 1;
 	}
 	// if both crashed or both not crashed, we compare distance and time
 
 	// biggest distance comes first
-	if (cr1.distance > cr2.distance) {
+	if (cr1->distance > cr2->distance) {
 		return -1;
-	} else if (cr1.distance < cr2.distance) {
+	} else if (cr1->distance < cr2->distance) {
 		return 1;
 	}
 
 	// same distance, better time comes first
-	return compareCarTime(cr1.totalTime, cr2.totalTime);
+	return compareCarTime(cr1->totalTime, cr2->totalTime);
 }
 
 // function to compare 2 car records
 // will be used to order the car during qualification, compare best lap, if equal, compare addition of the 3 bestSectionTime
 int compareCarStatQualification(const void * elem1, const void * elem2) {
-	CarStat cr1 = (CarStat)*(CarStat*)elem1;
-	CarStat cr2 = (CarStat)*(CarStat*)elem2;
-	int compareBestLap = compareCarTime(cr1.bestLap, cr2.bestLap);
+	const CarStat* cr1 = (const CarStat*)elem1;
+	const CarStat* cr2 = (const CarStat*)elem2;
+	int compareBestLap = compareCarTime(cr1->bestLap, cr2->bestLap);
 
 	// compare best lap
 	if (compareBestLap != 0) {
@@ -267,83 +893,56 @@ int compareCarStatQualification(const void * elem1, const void * elem2) {
 	}
 
 	// no best lap or the same, compare best s1, s2, s3
-	CarTime ct1, ct2;
-	ct1.seconds=0;
-	ct1.milliseconds=0;
-	ct2.seconds=0;
-	ct2.milliseconds=0;
-	for (int section=0;section<3;section++) {
-		combineCarTime(&ct1,cr1.bestSectionTime[section]);
-		combineCarTime(&ct2,cr2.bestSectionTime[section]);
-	}
+	CarTime ct1 = cr1->bestSectionTime[0] + cr1->bestSectionTime[1] + cr1->bestSectionTime[2];
+	CarTime ct2 = cr2->bestSectionTime[0] + cr2->bestSectionTime[1] + cr2->bestSectionTime[2];
 
 	return compareCarTime(ct1,ct2);
 }
 
-void subCarTime(CarTime *diff, const CarTime t1, const CarTime t2) {
-	diff->seconds=t1.seconds-t2.seconds;
-	diff->milliseconds=t1.milliseconds-t2.milliseconds;
-	if (diff->milliseconds<0) {
-		diff->milliseconds+=1000;
-		diff->seconds--;
-	}
-}
-
-// add t2 to t1, as t2 could be negative
-void combineCarTime(CarTime *t1, const CarTime t2) {
-	t1->milliseconds=t1->milliseconds+t2.milliseconds;
-	t1->seconds=t1->seconds+t2.seconds;
-	if (t1->milliseconds<0) {
-		t1->milliseconds+=1000;
-		t1->seconds--;
-	} else if (t1->milliseconds>=1000) {
-		t1->milliseconds-=1000;
-		t1->seconds++;
-	}
-}
-
-// Convert CarTime to String (format nnnn.nnn)
+// Convert CarTime to String (format nnnn.nnn, displayed to the millisecond)
 // digitCount could be 3 or 4
 void carTime2String(char* carTimeAsString, CarTime carTime, int digitCount) {
-	char pszFormat[9]; //"%{n}d.%03d"
+	char pszFormat[16]; //"%{n}lld.%03lld"
 
 	// initialize pszResult
 	memset(carTimeAsString,'\0',digitCount+1+3+1);
 
-	// create format string %{n}d%03d
-	sprintf(pszFormat,"%%%dd.%%03d",digitCount);
+	// create format string %{n}lld%03lld
+	sprintf(pszFormat,"%%%dlld.%%03lld",digitCount);
 
 	// Determine MAX value (will be replace by ---)
 	// we don't use pow function, don't want to load math library
-	int maxValue=10;
+	long long maxValue=10;
 	for(int i=0;i<digitCount-1;i++) {
 		maxValue*=10;
 	}
 	maxValue-=1; // 10^1-1 = 9, 10^2-1=99, ...
 
-	// if max value -> replace by ---
-	if (carTime.seconds == maxValue && carTime.milliseconds == 999) {
+	// if max value (or no time) -> replace by ---
+	if (carTime >= maxValue * CAR_TIME_SECOND + 999 * CAR_TIME_MILLISECOND || carTime >= CAR_TIME_NONE) {
 		// set all string to -
 		memset(carTimeAsString,'-',digitCount+1+3);
 		// add the .
 		carTimeAsString[digitCount]='.';
 	} else {
 		// format CarTime
-		sprintf(carTimeAsString,pszFormat,carTime.seconds, carTime.milliseconds);
+		sprintf(carTimeAsString,pszFormat,carTime / CAR_TIME_SECOND, (carTime % CAR_TIME_SECOND) / CAR_TIME_MILLISECOND);
 	}
 }
 
 // Convert CarTime to String (format h:mm:ss.nnn)
 void carTime2HMS(char* carTimeAsString, CarTime carTime) {
-	if (carTime.seconds<60) {
+	long long seconds = carTime / CAR_TIME_SECOND;
+	long long milliseconds = (carTime % CAR_TIME_SECOND) / CAR_TIME_MILLISECOND;
+	if (seconds<60) {
 		// SS.mmm
-		sprintf(carTimeAsString,"%2d.%03d",carTime.seconds,carTime.milliseconds);
-	} else if (carTime.seconds<60*60) {
+		sprintf(carTimeAsString,"%2lld.%03lld",seconds,milliseconds);
+	} else if (seconds<60*60) {
 		// MM:SS.mmm
-		sprintf(carTimeAsString,"%2d:%02d.%03d",carTime.seconds/60,carTime.seconds%60,carTime.milliseconds);
+		sprintf(carTimeAsString,"%2lld:%02lld.%03lld",seconds/60,seconds%60,milliseconds);
 	} else {
 		// H:MM:SS.mmm
-		sprintf(carTimeAsString,"%d:%02d:%02d.%03d",carTime.seconds/3600,(carTime.seconds/60)%60,carTime.seconds%60,carTime.milliseconds);
+		sprintf(carTimeAsString,"%lld:%02lld:%02lld.%03lld",seconds/3600,(seconds/60)%60,seconds%60,milliseconds);
 	}
 }
 
@@ -358,6 +957,32 @@ int millisWait(int millis) {
 	return millis;
 }
 
+// function to wait until deadline (CLOCK_MONOTONIC time in nanoseconds), return immediatly if deadline is past
+void deadlineWait(long long deadline) {
+	struct timespec ts;
+	ts.tv_sec = deadline / 1000000000LL;
+	ts.tv_nsec = deadline % 1000000000LL;
+	// restart the wait if interrupted by a signal, the deadline does not move
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// return CLOCK_MONOTONIC time in nanoseconds
+long long getMonotonicNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// add one measure to a latency statistic
+void addLatency(LatencyStat* latencyStat, long long nanos) {
+	latencyStat->count++;
+	latencyStat->totalNanos += nanos;
+	if (nanos > latencyStat->maxNanos) {
+		latencyStat->maxNanos = nanos;
+	}
+}
+
 char getConfirmation() {
     char input;
     while (1) {
@@ -397,7 +1022,7 @@ const char* racePhaseToShortString(enum RacePhase phase) {
 }
 
 char* getDriverName(int id) {
-	for(int i=0;i<MAX_PILOT;i++) {
+	for(int i=0;i<pilotCount;i++) {
 		if (drivers[i].id == id) {
 			return drivers[i].name;
 		}
@@ -461,15 +1086,15 @@ int getMaxPilotRunning(enum RacePhase phase) {
 		case FREE_PRACTICE_1:
 		case FREE_PRACTICE_2:
 		case FREE_PRACTICE_3:
-		case QUALIFICATION_1: return MAX_PILOT;
-		case QUALIFICATION_2: return 15;
-		case QUALIFICATION_3: return 10;
-		case SPRINT_QUALIFICATION_1: return MAX_PILOT;
-		case SPRINT_QUALIFICATION_2: return 15;
-		case SPRINT_QUALIFICATION_3: return 10;
-		case SPRINT: return MAX_PILOT;
-		case RACE: return MAX_PILOT;
-		default: return MAX_PILOT;
+		case QUALIFICATION_1: return pilotCount;
+		case QUALIFICATION_2: return options.q2Cut;
+		case QUALIFICATION_3: return options.q3Cut;
+		case SPRINT_QUALIFICATION_1: return pilotCount;
+		case SPRINT_QUALIFICATION_2: return options.q2Cut;
+		case SPRINT_QUALIFICATION_3: return options.q3Cut;
+		case SPRINT: return pilotCount;
+		case RACE: return pilotCount;
+		default: return pilotCount;
 	}
 }
 
@@ -488,25 +1113,47 @@ int comparePilotStat(const void * elem1, const void * elem2) {
 }
 
 // --------------------------------------------------------------------
-// read drivers.csv and store data into global variable drivers
-void readDriverData(DriverData *drivers) {
+// read drivers.csv, return the allocated drivers (1 per line) and their number in driverCount
+DriverData* readDriverData(int* driverCount) {
 	FILE *file = fopen("drivers.csv", "r");
+	DriverData* drivers = NULL;
 
-    int driverCount = 0;
-    if (file == NULL) {
+	*driverCount = 0;
+	if (file == NULL) {
 		perror("Unable to read drivers");
 		exit(1);
 	} else {
 		char line[100]; // Buffer
-		while (fgets(line, sizeof(line), file) && driverCount < MAX_PILOT) {
+		// 1st pass: count the pilots to allocate the grid
+		int lineCount = 0;
+		while (fgets(line, sizeof(line), file)) {
+			// empty lines are skipped (also with CRLF line endings)
+			line[strcspn(line, "\r\n")] = '\0';
+			if (line[0] != '\0') {
+				lineCount++;
+			}
+		}
+		drivers = calloc(lineCount > 0 ? lineCount : 1, sizeof(DriverData));
+		if (!drivers) {
+			perror("Unable to allocate drivers");
+			exit(1);
+		}
+
+		rewind(file);
+		while (fgets(line, sizeof(line), file) && *driverCount < lineCount) {
+			line[strcspn(line, "\r\n")] = '\0';
+			if (line[0] == '\0') {
+				continue;
+			}
 			// Read ID and Name (max 49 character long)
-			sscanf(line, "%d;%3[^;];%49[^\n]", &drivers[driverCount].id, drivers[driverCount].shortName, drivers[driverCount].name);
+			sscanf(line, "%d;%3[^;];%49[^\n]", &drivers[*driverCount].id, drivers[*driverCount].shortName, drivers[*driverCount].name);
 			// increment counter
-			driverCount++;
+			(*driverCount)++;
 		}
 
 		fclose(file);
 	}
+	return drivers;
 }
 
 // read tracks.csv and store data into global variable tracks
@@ -538,41 +1185,135 @@ void readTrackData(TrackData* tracks) {
 	}
 }
 
-void savePhaseResult(int race, enum RacePhase phase, int pilotRunning) {
+// seed = seed of the session, saved in the header to replay the session
+// the result is saved in race_nn_pp.bin (fixed records, read with mmap by loadPhaseResult) and in race_nn_pp.csv for humans (except with --no-csv)
+void savePhaseResult(int race, enum RacePhase phase, uint64_t seed) {
+	// records in the running order kept by the controller (the pilots not running stay in the order of the grid)
+	ResultRecord* records = calloc(pilotCount, sizeof(ResultRecord));
+	if (!records) {
+		perror("Unable to save phase result.bin");
+		exit(1);
+	}
+	for (int position=0;position<pilotCount;position++) {
+		CarStat carStat;
+		getCarStat(sharedMemory->ranking[position], &carStat);
+		records[position].pilotNumber = carStat.pilotNumber;
+		records[position].bestLap = carStat.bestLap;
+		for (int section=0;section<3;section++) {
+			records[position].bestSectionTime[section] = carStat.bestSectionTime[section];
+		}
+	}
+	ResultFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RESULT_FILE_MAGIC, sizeof(header.magic));
+	header.version = RESULT_FILE_VERSION;
+	header.recordSize = sizeof(ResultRecord);
+	header.recordCount = pilotCount;
+	header.seed = seed;
+
 	// determine filename
 	char filename[25];
-	sprintf(filename,"race_%02d_%s.csv",race+1,racePhaseToShortString(phase));
+	sprintf(filename,"race_%02d_%s.bin",race+1,racePhaseToShortString(phase));
+	FILE* file = fopen(filename,"wb");
+	if (!file || fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(records, sizeof(ResultRecord), pilotCount, file) != (size_t)pilotCount) {
+		// error while creating the file
+		perror("Unable to save phase result.bin");
+		exit(1);
+	}
+	fclose(file);
+
+	if (!options.noCsv) {
+		sprintf(filename,"race_%02d_%s.csv",race+1,racePhaseToShortString(phase));
+		writeResultCsv(filename, records, pilotCount, seed);
+	}
+	free(records);
+}
+
+// write the records of a result in csv (1 line per pilot, the seed on the last line: # seed=n)
+void writeResultCsv(const char* filename, const ResultRecord* records, int recordCount, uint64_t seed) {
 	FILE* file = fopen(filename,"w");
 	if (!file) {
 		// error while creating the file
 		perror("Unable to save phase result.csv");
 		exit(1);
 	} else {
-		// Sort data
-		CarStat carStats[MAX_PILOT] = {0};
-		memcpy(carStats, &sharedMemory->carStats, sizeof(CarStat)*MAX_PILOT);
-		if (phase == SPRINT || phase == RACE) {
-			qsort(carStats,pilotRunning,sizeof(CarStat),compareCarStatRace);
-		} else {
-			qsort(carStats,pilotRunning,sizeof(CarStat),compareCarStatQualification);
-		}
-
-		// Save data
-		for (int pilot=0;pilot<MAX_PILOT;pilot++) {
+		for (int position=0;position<recordCount;position++) {
+			const ResultRecord* record = &records[position];
 			// save pilot id, bestLap, bestS1, bestS2, bestS3
-			fprintf(file,"%d;%d.%d;%d.%d;%d.%d;%d.%d\n",
-				carStats[pilot].pilotNumber,
-				carStats[pilot].bestLap.seconds, carStats[pilot].bestLap.milliseconds,
-				carStats[pilot].bestSectionTime[0].seconds, carStats[pilot].bestSectionTime[0].milliseconds,
-				carStats[pilot].bestSectionTime[1].seconds, carStats[pilot].bestSectionTime[1].milliseconds,
-				carStats[pilot].bestSectionTime[2].seconds, carStats[pilot].bestSectionTime[2].milliseconds
+			// times are saved in seconds with 6 decimals (microseconds)
+			fprintf(file,"%d;%lld.%06lld;%lld.%06lld;%lld.%06lld;%lld.%06lld\n",
+				record->pilotNumber,
+				(long long)(record->bestLap / CAR_TIME_SECOND), (long long)(record->bestLap % CAR_TIME_SECOND),
+				(long long)(record->bestSectionTime[0] / CAR_TIME_SECOND), (long long)(record->bestSectionTime[0] % CAR_TIME_SECOND),
+				(long long)(record->bestSectionTime[1] / CAR_TIME_SECOND), (long long)(record->bestSectionTime[1] % CAR_TIME_SECOND),
+				(long long)(record->bestSectionTime[2] / CAR_TIME_SECOND), (long long)(record->bestSectionTime[2] % CAR_TIME_SECOND)
 			);
 		}
+		fprintf(file,"# seed=%llu\n", (unsigned long long)seed);
 	}
 	fclose(file);
 }
 
+// map race_nn_pp.bin in memory (read only), the records follow the header: records[n] = position n
+// return NULL if the file doesn't exist, stop the program if it isn't a valid result file
+const ResultFileHeader* mapResultFile(int race, enum RacePhase phase, size_t* size) {
+	char filename[25];
+	sprintf(filename,"race_%02d_%s.bin",race+1,racePhaseToShortString(phase));
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		if (errno == ENOENT) {
+			return NULL;
+		}
+		perror("Unable to read phase result.bin");
+		exit(1);
+	}
+	off_t fileSize = lseek(fd, 0, SEEK_END);
+	if (fileSize < (off_t)sizeof(ResultFileHeader)) {
+		fprintf(stderr, "%s: invalid result file\n", filename);
+		exit(1);
+	}
+	const ResultFileHeader* header = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		perror("Unable to map phase result.bin");
+		exit(1);
+	}
+	// the records are used as they are on disk: same version, same size of record and complete file
+	if (memcmp(header->magic, RESULT_FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != RESULT_FILE_VERSION
+			|| header->recordSize != sizeof(ResultRecord)
+			|| (off_t)(sizeof(ResultFileHeader) + (size_t)header->recordCount * sizeof(ResultRecord)) != fileSize) {
+		fprintf(stderr, "%s: invalid result file\n", filename);
+		exit(1);
+	}
+	*size = fileSize;
+	return header;
+}
+
+// read the result of a session: race_nn_pp.bin, or race_nn_pp.csv for the championships started before the binary format
 void loadPhaseResult(CarStat* carStats, int race, enum RacePhase phase) {
+	size_t size;
+	const ResultFileHeader* header = mapResultFile(race, phase, &size);
+	if (!header) {
+		loadPhaseResultCsv(carStats, race, phase);
+		return;
+	}
+	if (header->recordCount != (uint32_t)pilotCount) {
+		fprintf(stderr, "race_%02d_%s.bin: %u pilots, %d in drivers.csv\n", race+1, racePhaseToShortString(phase), header->recordCount, pilotCount);
+		exit(1);
+	}
+	const ResultRecord* records = (const ResultRecord*)(header + 1);
+	for (int pilot=0;pilot<pilotCount;pilot++) {
+		carStats[pilot].pilotNumber = records[pilot].pilotNumber;
+		carStats[pilot].bestLap = records[pilot].bestLap;
+		for (int section=0;section<3;section++) {
+			carStats[pilot].bestSectionTime[section] = records[pilot].bestSectionTime[section];
+		}
+		carStats[pilot].inStand = true;
+	}
+	munmap((void*)header, size);
+}
+
+void loadPhaseResultCsv(CarStat* carStats, int race, enum RacePhase phase) {
 	// determine filename
 	char filename[25];
 	sprintf(filename,"race_%02d_%s.csv",race+1,racePhaseToShortString(phase));
@@ -584,25 +1325,54 @@ void loadPhaseResult(CarStat* carStats, int race, enum RacePhase phase) {
 		exit(1);
 	}
 
-	for (int pilot=0;pilot<MAX_PILOT;pilot++) {
-		// read pilot id, bestLap, bestS1, bestS2, bestS3
-		if (!fscanf(file, "%d;%d.%d;%d.%d;%d.%d;%d.%d\n",
-				&carStats[pilot].pilotNumber,
-				&carStats[pilot].bestLap.seconds, &carStats[pilot].bestLap.milliseconds,
-				&carStats[pilot].bestSectionTime[0].seconds, &carStats[pilot].bestSectionTime[0].milliseconds,
-				&carStats[pilot].bestSectionTime[1].seconds, &carStats[pilot].bestSectionTime[1].milliseconds,
-				&carStats[pilot].bestSectionTime[2].seconds, &carStats[pilot].bestSectionTime[2].milliseconds
-			)) {
+	for (int pilot=0;pilot<pilotCount;pilot++) {
+		// read pilot id, bestLap, bestS1, bestS2, bestS3 (see parseCarTime for the format of the times)
+		char line[200];
+		char times[4][32];
+		if (!fgets(line, sizeof(line), file) || sscanf(line, "%d;%31[^;];%31[^;];%31[^;];%31[^;\n]",
+				&carStats[pilot].pilotNumber, times[0], times[1], times[2], times[3]) != 5) {
 			// file content is invalid
 			perror("unable to read result file");
 			exit(1);
 		}
+		carStats[pilot].bestLap = parseCarTime(times[0]);
+		for (int section=0;section<3;section++) {
+			carStats[pilot].bestSectionTime[section] = parseCarTime(times[section+1]);
+		}
 		carStats[pilot].inStand = true;
 	}
 	fclose(file);
 }
 
+// --export-csv: write race_nn_pp.csv from every race_nn_pp.bin of the championship
+void exportResultCsv() {
+	int exported = 0;
+	for (int race=0;race<MAX_TRACK;race++) {
+		for (enum RacePhase phase=FREE_PRACTICE_1;phase<=RACE;phase++) {
+			size_t size;
+			const ResultFileHeader* header = mapResultFile(race, phase, &size);
+			if (header) {
+				char filename[25];
+				sprintf(filename,"race_%02d_%s.csv",race+1,racePhaseToShortString(phase));
+				writeResultCsv(filename, (const ResultRecord*)(header + 1), header->recordCount, header->seed);
+				munmap((void*)header, size);
+				exported++;
+			}
+		}
+	}
+	printf("%d result files exported in csv\n", exported);
+}
+
+// save the points of the sprint/race in race_nn_pp_ranking.csv and add them to the standings (standings.bin)
 void saveChampionshipResult(int race, enum RacePhase phase) {
+	int* pilotNumbers = malloc(pilotCount * sizeof(int));
+	int* points = malloc(pilotCount * sizeof(int));
+	StandingsRecord* records = malloc(pilotCount * sizeof(StandingsRecord));
+	if (!pilotNumbers || !points || !records) {
+		perror("Unable to save championship ranking.csv");
+		exit(1);
+	}
+
 	// determine filename
 	char filename[25];
 	sprintf(filename,"race_%02d_%s_ranking.csv",race+1,racePhaseToShortString(phase));
@@ -613,73 +1383,187 @@ void saveChampionshipResult(int race, enum RacePhase phase) {
 		perror("Unable to save championship ranking.csv");
 		exit(1);
 	} else {
-		// Sort race data
-		CarStat carStats[MAX_PILOT];
-		memcpy(carStats, sharedMemory->carStats, sizeof(CarStat)*MAX_PILOT);
-		qsort(carStats,MAX_PILOT,sizeof(CarStat),compareCarStatRace);
-
-		// Save data
-		for (int position=0;position<MAX_PILOT;position++) {
+		// Save data in the running order kept by the controller
+		for (int position=0;position<pilotCount;position++) {
 			// save pilot id, point for the race
-			fprintf(file,"%d;%d\n",	carStats[position].pilotNumber, getScore(position,phase));
+			pilotNumbers[position] = sharedMemory->carStats.pilotNumber[sharedMemory->ranking[position]];
+			points[position] = getScore(position,phase);
+			fprintf(file,"%d;%d\n", pilotNumbers[position], points[position]);
 		}
 	}
 	fclose(file);
+
+	// update the standings with this round only
+	StandingsFileHeader header;
+	int round = getStandingsRound(race, phase);
+	if (!readStandings(&header, records) || (header.appliedRounds >> (round + 1)) != 0) {
+		// no standings (or standings of a previous championship): count all the ranking files up to this one
+		rebuildStandings(round, &header, records);
+	} else {
+		applyRoundToStandings(&header, records, round, pilotNumbers, points, pilotCount);
+	}
+	writeStandings(&header, records);
+	free(pilotNumbers);
+	free(points);
+	free(records);
 }
 
-void loadFinalChampionshipResult(int raceNumber, PilotStat* pilotStats, DriverData* drivers) {
-	// read all ranking files and compute pilot result
-	// Initialize results
-	for (int i=0;i<MAX_PILOT;i++) {
+// standings of the championship after the race raceNumber (sprint and race included), 1 PilotStat per driver (not sorted)
+// read from standings.bin, rebuilt from the ranking files if it doesn't exist (or is invalid, or contains later rounds)
+// return the number of sprints/races counted
+int loadFinalChampionshipResult(int raceNumber, PilotStat* pilotStats, DriverData* drivers) {
+	StandingsFileHeader header;
+	StandingsRecord* records = malloc(pilotCount * sizeof(StandingsRecord));
+	if (!records) {
+		perror("Unable to read standings.bin");
+		exit(1);
+	}
+	int lastRound = getStandingsRound(raceNumber, RACE);
+	if (!readStandings(&header, records) || (header.appliedRounds >> (lastRound + 1)) != 0) {
+		rebuildStandings(lastRound, &header, records);
+		writeStandings(&header, records);
+	}
+
+	// the records are in the order of the drivers
+	for (int i=0;i<pilotCount;i++) {
 		pilotStats[i].pilotNumber=drivers[i].id;
 		strcpy(pilotStats[i].name, drivers[i].name);
-		pilotStats[i].score=0;
-		pilotStats[i].raceWon=0;
-	}
-
-	// loop on races and sprints
-	enum RacePhase racePhases[2];
-	racePhases[0]=SPRINT;
-	racePhases[1]=RACE;
-	for (int race=0;race<=raceNumber;race++) {
-		for (int phase=0;phase<2;phase++) {
-			int pilotNumber=0;
-			int score=0;
-
-			char filename[25];
-			// create filename
-			sprintf(filename,"race_%02d_%s_ranking.csv",race+1,racePhaseToShortString(racePhases[phase]));
-			// check if file exist:
-			if (access(filename, F_OK) != 0) {
-				// file does not exist, skip
-				continue;
-			}
+		pilotStats[i].score=records[i].score;
+		pilotStats[i].raceWon=records[i].raceWon;
+	}
+	free(records);
+	return __builtin_popcountll(header.appliedRounds);
+}
 
-			FILE* file = fopen(filename,"r");
-			if (!file) {
-				perror("Unable to open ranking file");
-				exit(1);
-			}
+// index of a round in the standings (2 rounds by race: sprint and race)
+int getStandingsRound(int race, enum RacePhase phase) {
+	return race * 2 + (phase == RACE ? 1 : 0);
+}
 
-			// read result
-			for (int i=0;i<MAX_PILOT;i++) {
-				// read ranking line
-				fscanf(file, "%d;%d\n",&pilotNumber,&score);
-
-				// search pilot in the list and update score
-				for (int j=0;j<MAX_PILOT;j++) {
-					if (pilotStats[j].pilotNumber == pilotNumber) {
-						pilotStats[j].score+=score;
-						if (i==0) {
-							// pilot won the race
-							pilotStats[j].raceWon++;
-						}
-						break;
-					}
-				}
+// index of a pilot in drivers (-1 if unknown)
+int findDriver(int pilotNumber) {
+	for (int i=0;i<pilotCount;i++) {
+		if (drivers[i].id == pilotNumber) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// empty standings: no round applied, 1 record per driver
+void initStandings(StandingsFileHeader* header, StandingsRecord* records) {
+	memset(header, 0, sizeof(StandingsFileHeader));
+	memcpy(header->magic, STANDINGS_FILE_MAGIC, sizeof(header->magic));
+	header->version = STANDINGS_FILE_VERSION;
+	header->recordSize = sizeof(StandingsRecord);
+	header->recordCount = pilotCount;
+	memset(records, 0, pilotCount * sizeof(StandingsRecord));
+	for (int i=0;i<pilotCount;i++) {
+		records[i].pilotNumber = drivers[i].id;
+	}
+}
+
+// read standings.bin, return false if it doesn't exist or doesn't match drivers.csv (the standings must be rebuilt)
+bool readStandings(StandingsFileHeader* header, StandingsRecord* records) {
+	FILE* file = fopen("standings.bin","rb");
+	if (!file) {
+		return false;
+	}
+	bool valid = fread(header, sizeof(StandingsFileHeader), 1, file) == 1
+		&& memcmp(header->magic, STANDINGS_FILE_MAGIC, sizeof(header->magic)) == 0
+		&& header->version == STANDINGS_FILE_VERSION
+		&& header->recordSize == sizeof(StandingsRecord)
+		&& header->recordCount == (uint32_t)pilotCount
+		&& fread(records, sizeof(StandingsRecord), pilotCount, file) == (size_t)pilotCount
+		&& fgetc(file) == EOF;
+	fclose(file);
+	for (int i=0;valid && i<pilotCount;i++) {
+		valid = records[i].pilotNumber == drivers[i].id;
+	}
+	return valid;
+}
+
+// write standings.bin (in a temporary file renamed at the end: an interrupted write keeps the previous standings)
+void writeStandings(const StandingsFileHeader* header, const StandingsRecord* records) {
+	FILE* file = fopen("standings.bin.tmp","wb");
+	if (!file || fwrite(header, sizeof(StandingsFileHeader), 1, file) != 1
+			|| fwrite(records, sizeof(StandingsRecord), header->recordCount, file) != header->recordCount) {
+		perror("Unable to save standings.bin");
+		exit(1);
+	}
+	if (fclose(file) != 0 || rename("standings.bin.tmp", "standings.bin") != 0) {
+		perror("Unable to save standings.bin");
+		exit(1);
+	}
+}
+
+// add the points of a round (pilotNumbers in finishing order), a round already applied is replaced
+void applyRoundToStandings(StandingsFileHeader* header, StandingsRecord* records, int round, const int* pilotNumbers, const int* points, int count) {
+	uint64_t roundBit = (uint64_t)1 << round;
+	if (header->appliedRounds & roundBit) {
+		// remove the previous result of the round
+		for (int i=0;i<pilotCount;i++) {
+			records[i].score -= records[i].roundPoints[round];
+			records[i].roundPoints[round] = 0;
+			if (records[i].roundsWon & roundBit) {
+				records[i].raceWon--;
+				records[i].roundsWon &= ~roundBit;
 			}
 		}
 	}
+	for (int position=0;position<count;position++) {
+		int driver = findDriver(pilotNumbers[position]);
+		if (driver == -1) {
+			// pilot no longer in drivers.csv
+			continue;
+		}
+		records[driver].score += points[position];
+		records[driver].roundPoints[round] = points[position];
+		if (position == 0) {
+			// pilot won the race
+			records[driver].raceWon++;
+			records[driver].roundsWon |= roundBit;
+		}
+	}
+	header->appliedRounds |= roundBit;
+}
+
+// standings computed from all the ranking files of the rounds 0 to lastRound (--rebuild-standings, or no valid standings.bin)
+void rebuildStandings(int lastRound, StandingsFileHeader* header, StandingsRecord* records) {
+	int* pilotNumbers = malloc(pilotCount * sizeof(int));
+	int* points = malloc(pilotCount * sizeof(int));
+	if (!pilotNumbers || !points) {
+		perror("Unable to read ranking files");
+		exit(1);
+	}
+	initStandings(header, records);
+	for (int round=0;round<=lastRound;round++) {
+		enum RacePhase phase = round % 2 == 0 ? SPRINT : RACE;
+		char filename[25];
+		// create filename
+		sprintf(filename,"race_%02d_%s_ranking.csv",round/2+1,racePhaseToShortString(phase));
+		// check if file exist:
+		if (access(filename, F_OK) != 0) {
+			// file does not exist, skip
+			continue;
+		}
+
+		FILE* file = fopen(filename,"r");
+		if (!file) {
+			perror("Unable to open ranking file");
+			exit(1);
+		}
+
+		// read result
+		int count = 0;
+		while (count < pilotCount && fscanf(file, "%d;%d\n", &pilotNumbers[count], &points[count]) == 2) {
+			count++;
+		}
+		fclose(file);
+		applyRoundToStandings(header, records, round, pilotNumbers, points, count);
+	}
+	free(pilotNumbers);
+	free(points);
 }
 
 // ------------------------------------------------------------------------------------
@@ -703,25 +1587,20 @@ void getDifferences(char (*differences)[9], CarStat* sorted, bool compareWithFir
 					// 1st just overtake 2nd car (so totalTime is not relevant)
 					strcpy(differences[i],"over");
 				} else {
-					subCarTime(&ctDiff,sorted[i].totalTime,sorted[indexCompare].totalTime);
+					ctDiff = sorted[i].totalTime - sorted[indexCompare].totalTime;
 					carTime2String(differences[i],ctDiff,3);
 				}
 			} else if ((sorted[indexCompare].distance-sorted[i].distance)<3) {
 				// not the same lap, add last section time between to compare same timing
-				CarTime estimatedTotalTime;
-				estimatedTotalTime.seconds=sorted[i].totalTime.seconds;
-				estimatedTotalTime.milliseconds=sorted[i].totalTime.milliseconds;
-				combineCarTime(&estimatedTotalTime,sorted[i].currentSectionTime[0]);
-				combineCarTime(&estimatedTotalTime,sorted[i].currentSectionTime[1]);
+				CarTime estimatedTotalTime = sorted[i].totalTime + sorted[i].currentSectionTime[0] + sorted[i].currentSectionTime[1];
 
 				// compare to see if 2nd car is not about to overtake 1st car ?
 				if (compareCarTime(sorted[indexCompare].totalTime,estimatedTotalTime)>=0) {
 					// 2nd car is about to overtake 1st car, create fictive diff
-					ctDiff.seconds=0;
-					ctDiff.milliseconds=(sorted[indexCompare].totalTime.milliseconds+estimatedTotalTime.milliseconds) % 1000;
+					ctDiff = (sorted[indexCompare].totalTime % CAR_TIME_SECOND + estimatedTotalTime % CAR_TIME_SECOND) % CAR_TIME_SECOND;
 				} else {
 					// calculate difference
-					subCarTime(&ctDiff,estimatedTotalTime,sorted[indexCompare].totalTime);
+					ctDiff = estimatedTotalTime - sorted[indexCompare].totalTime;
 				}
 				carTime2String(differences[i],ctDiff,3);
 			} else {
@@ -732,55 +1611,57 @@ void getDifferences(char (*differences)[9], CarStat* sorted, bool compareWithFir
 		}
 	}
 	// no difference for pilot not running
-	for (int i=pilotRunning;i<MAX_PILOT;i++) {
+	for (int i=pilotRunning;i<pilotCount;i++) {
 		strcpy(differences[i],"");
 	}
 }
 
 // function to display on the screen the carStats
+// screen = cells of the last frame drawn (only the changes are sent to the terminal)
+// ranking = running order published by the controller (ranking[position] = index in carStats)
+// previousPosition = position of each car at the previous display (previousPosition[car])
 // race = true we are in sprint or race
 // pilotRunning = pilot running (in Q2/Q3 not all pilots are running)
-void displayData(const CarStat* carStats, const CarStat* carStatsPrevious, bool race, int pilotRunning) {
-	// create a copy of the car records (qsort will modify the order)
-	CarStat sorted[MAX_PILOT] = {0};
-	CarStat sortedPrevious[MAX_PILOT] = {0};
-	memcpy(sorted,carStats,sizeof(CarStat)*MAX_PILOT);
-	memcpy(sortedPrevious,carStatsPrevious,sizeof(CarStat)*MAX_PILOT);
-	// sort the car records
-	if (race) {
-		qsort(sorted,pilotRunning,sizeof(CarStat),compareCarStatRace);
-		qsort(sortedPrevious,pilotRunning,sizeof(CarStat),compareCarStatRace);
-	} else {
-		qsort(sorted,pilotRunning,sizeof(CarStat),compareCarStatQualification);
-		qsort(sortedPrevious,pilotRunning,sizeof(CarStat),compareCarStatQualification);
+void displayData(ScreenBuffer* screen, const CarStat* carStats, const int* ranking, const int* previousPosition, bool race, int pilotRunning) {
+	// the arrays sized by the grid are not on the stack (a big drivers.csv, the stack of a thread with --threads)
+	if (!screen->sorted) {
+		screen->sorted = malloc(pilotCount * sizeof(CarStat));
+		screen->positionUpdates = malloc(pilotCount * sizeof(const char*));
+		screen->differences = malloc(pilotCount * sizeof(*screen->differences));
+		screen->differences1st = malloc(pilotCount * sizeof(*screen->differences1st));
+		screen->crashed = malloc(pilotCount * sizeof(bool));
+		if (!screen->sorted || !screen->positionUpdates || !screen->differences || !screen->differences1st || !screen->crashed) {
+			perror("Unable to allocate the screen buffer");
+			exit(1);
+		}
+	}
+
+	// copy the car records in the running order (no sort needed, the controller keeps the ranking up to date)
+	CarStat* sorted = screen->sorted;
+	for (int i=0;i<pilotCount;i++) {
+		sorted[i] = carStats[ranking[i]];
 	}
 
 	// cars not running wait in stand (during Q2, Q3, ...)
-	for (int i=pilotRunning;i<MAX_PILOT;i++){
+	for (int i=pilotRunning;i<pilotCount;i++){
 		sorted[i].inStand = true;
 	}
 
 	// determine who has best lap and best section 1, 2 or 3
 	int indexBestLap = -1;
 	int indexBestSection[3] = {-1};
-	CarTime ctBestLap;
-	CarTime ctBestSection[3];
-	ctBestLap.seconds=999;
-	ctBestSection[0].seconds=99;
-	ctBestSection[1].seconds=99;
-	ctBestSection[2].seconds=99;
+	CarTime ctBestLap = CAR_TIME_NONE;
+	CarTime ctBestSection[3] = { CAR_TIME_NONE, CAR_TIME_NONE, CAR_TIME_NONE };
 
 	for (int i=0;i<pilotRunning;i++) {
 		if (compareCarTime(sorted[i].bestLap,ctBestLap) < 0) {
-			ctBestLap.seconds=sorted[i].bestLap.seconds;
-			ctBestLap.milliseconds=sorted[i].bestLap.milliseconds;
+			ctBestLap=sorted[i].bestLap;
 			indexBestLap=i;
 		}
 
 		for (int j=0;j<3;j++) {
 			if (compareCarTime(sorted[i].bestSectionTime[j],ctBestSection[j]) < 0) {
-				ctBestSection[j].seconds=sorted[i].bestSectionTime[j].seconds;
-				ctBestSection[j].milliseconds=sorted[i].bestSectionTime[j].milliseconds;
+				ctBestSection[j]=sorted[i].bestSectionTime[j];
 				indexBestSection[j]=i;
 			}
 		}
@@ -788,33 +1669,33 @@ void displayData(const CarStat* carStats, const CarStat* carStatsPrevious, bool
 
 	// Determine if pilot's position changed
 	//  could be =, ↑ or ↓
-	char* posUpd[MAX_PILOT];
+	const char** posUpd = screen->positionUpdates;
 	for(int i=0;i<pilotRunning;i++) {
-		posUpd[i]="\033[32m↑\033[0m"; // if pilot is not discovered at the same position or below, it must be better ;-)
-		if (sorted[i].pilotNumber == sortedPrevious[i].pilotNumber) {
+		if (previousPosition[ranking[i]] == i) {
 			posUpd[i]="="; // pilot is at same position
+		} else if (previousPosition[ranking[i]] > i) {
+			posUpd[i]="\033[32m↑\033[0m"; // pilot has gained position
 		} else {
-			for(int j=0;j<i;j++) {
-				if (sorted[i].pilotNumber == sortedPrevious[j].pilotNumber) {
-					posUpd[i]="\033[31m↓\033[0m"; // pilot has lost position
-				}
-			}
+			posUpd[i]="\033[31m↓\033[0m"; // pilot has lost position
 		}
 	}
 	// no update for pilot not running
-	for (int i=pilotRunning;i<MAX_PILOT;i++) {
+	for (int i=pilotRunning;i<pilotCount;i++) {
 		posUpd[i]=" "; // if pilot is not discovered at the same position or below, it must be better ;-)
 	}
 
 	// Determine difference between 2 pilots and difference with 1st
-	char differences[MAX_PILOT][9] = {0};
-	char differences1st[MAX_PILOT][9] = {0};
+	char (*differences)[9] = screen->differences;
+	char (*differences1st)[9] = screen->differences1st;
+	memset(differences, 0, pilotCount * sizeof(*differences));
+	memset(differences1st, 0, pilotCount * sizeof(*differences1st));
 	getDifferences(differences, sorted, false, pilotRunning);
 	getDifferences(differences1st, sorted, true, pilotRunning);
 
 	// display if anyone is CRASHED
-	bool crashedIndex[MAX_PILOT]={false};
-	for(int i=0;i<MAX_PILOT;i++) {
+	bool* crashedIndex = screen->crashed;
+	memset(crashedIndex, 0, pilotCount * sizeof(bool));
+	for(int i=0;i<pilotCount;i++) {
 		if (sorted[i].crashed) {
 			strcpy(differences[i],"--OUT--");
 			strcpy(differences1st[i],"--OUT--");
@@ -826,25 +1707,60 @@ void displayData(const CarStat* carStats, const CarStat* carStatsPrevious, bool
 	struct winsize w;
 	ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
 
-	// print using ANSI ESCAPE sequence
-	// \033[s = save current cursor position
-	// \033[u = restore cursor to previously saved position
-	// \033[{line};{column}H = move cursor to position {col}, {column}
+	// only display the pilots that fit in the screen (3 lines of header + 1 line at the bottom)
+	int displayRows = pilotCount;
+	int terminalRows = getTerminalRows();
+	if (terminalRows > 4 && displayRows > terminalRows - 4) {
+		displayRows = terminalRows - 4;
+	}
 
-	printf("\033[s");
+	// width of the cells and borders of the table (race or qualification)
+	static const int raceWidths[SCREEN_MAX_COLUMNS] = { 6, 8, 9, 13, 9, 9, 10, 9, 9, 9, 5 };
+	static const int qualificationWidths[SCREEN_MAX_COLUMNS] = { 6, 8, 10, 10, 9, 9, 9 };
+	static const char* const raceBorders[4] = {
+		"┌──────┬────────┬─────────┬─────────────┬─────────┬─────────┬──────────┬─────────┬─────────┬─────────┬─────┐",
+		"│  #   │ Driver │ dist.   │  total      │ diff.   │ dif 1st │ best lap │ best s1 │ best s2 │ best s3 │ pit │",
+		"├──────┼────────┼─────────┼─────────────┼─────────┼─────────┼──────────┼─────────┼─────────┼─────────┼─────┤",
+		//"│ nn = │ nn-XXX │ nn (Sn) │ h:mm:ss.nnn │ XXX.XXX │ XXX.XXX │  nnn.nnn │ nnn.nnn │ nnn.nnn │ nnn.nnn │  n  │
+		"└──────┴────────┴─────────┴─────────────┴─────────┴─────────┴──────────┴─────────┴─────────┴─────────┴─────┘"
+	};
+	static const char* const qualificationBorders[4] = {
+		"┌──────┬────────┬──────────┬──────────┬─────────┬─────────┬─────────┐",
+		"│  #   │ Driver │ status   │ best lap │ best s1 │ best s2 │ best s3 │",
+		"├──────┼────────┼──────────┼──────────┼─────────┼─────────┼─────────┤",
+		//"│ nn = │ nn-XXX │ IN STAND │  nnn.nnn │ nnn.nnn │ nnn.nnn │ nnn.nnn │
+		"└──────┴────────┴──────────┴──────────┴─────────┴─────────┴─────────┘"
+	};
 	if (race) {
-		printf("\033[%d;%dH%s", 1, w.ws_col-108, "┌──────┬────────┬─────────┬─────────────┬─────────┬─────────┬──────────┬─────────┬─────────┬─────────┬─────┐");
-		printf("\033[%d;%dH%s", 2, w.ws_col-108, "│  #   │ Driver │ dist.   │  total      │ diff.   │ dif 1st │ best lap │ best s1 │ best s2 │ best s3 │ pit │");
-		printf("\033[%d;%dH%s", 3, w.ws_col-108, "├──────┼────────┼─────────┼─────────────┼─────────┼─────────┼──────────┼─────────┼─────────┼─────────┼─────┤");
-		//                                       "│ nn = │ nn-XXX │ nn (Sn) │ h:mm:ss.nnn │ XXX.XXX │ XXX.XXX │  nnn.nnn │ nnn.nnn │ nnn.nnn │ nnn.nnn │  n  │
+		resizeScreenBuffer(screen, displayRows, 11, w.ws_col-108, raceWidths);
 	} else {
-		printf("\033[%d;%dH%s", 1, w.ws_col-68,  "┌──────┬────────┬──────────┬──────────┬─────────┬─────────┬─────────┐");
-		printf("\033[%d;%dH%s", 2, w.ws_col-68,  "│  #   │ Driver │ status   │ best lap │ best s1 │ best s2 │ best s3 │");
-		printf("\033[%d;%dH%s", 3, w.ws_col-68,  "├──────┼────────┼──────────┼──────────┼─────────┼─────────┼─────────┤");
-		//                                       "│ nn = │ nn-XXX │ IN STAND │  nnn.nnn │ nnn.nnn │ nnn.nnn │ nnn.nnn │
+		resizeScreenBuffer(screen, displayRows, 7, w.ws_col-68, qualificationWidths);
 	}
 
-	for (int i=0;i<MAX_PILOT;i++) {
+	// fill the cells of the frame (only the cells that changed will be drawn)
+	for (int i=0;i<displayRows;i++) {
+		// the rows with the same data as in the previous frame are not formatted again
+		ScreenRowSource source;
+		memset(&source, 0, sizeof(source));
+		source.pilotNumber = sorted[i].pilotNumber;
+		source.distance = sorted[i].distance;
+		source.totalTime = sorted[i].totalTime;
+		source.bestLap = sorted[i].bestLap;
+		memcpy(source.bestSectionTime, sorted[i].bestSectionTime, sizeof(source.bestSectionTime));
+		source.pitStopCount = sorted[i].pitStopCount;
+		source.crashed = crashedIndex[i];
+		source.inStand = sorted[i].inStand;
+		source.positionUpdate = posUpd[i];
+		strcpy(source.difference, differences[i]);
+		strcpy(source.difference1st, differences1st[i]);
+		source.highlights = (i==indexBestLap && ctBestLap != CAR_TIME_NONE);
+		for (int j=0;j<3;j++) {
+			source.highlights |= (i==indexBestSection[j] && ctBestSection[j] != CAR_TIME_NONE) << (j+1);
+		}
+		if (reuseScreenRow(screen, i, &source)) {
+			continue;
+		}
+
 		char bestLap[8],bestS1[8],bestS2[8],bestS3[8];
 		// convert CarTimes to Strings
 		carTime2String(bestLap,sorted[i].bestLap,3);
@@ -852,73 +1768,285 @@ void displayData(const CarStat* carStats, const CarStat* carStatsPrevious, bool
 		carTime2String(bestS2,sorted[i].bestSectionTime[1],3);
 		carTime2String(bestS3,sorted[i].bestSectionTime[2],3);
 
+		setScreenCell(screen, i, 0, " %2d %s ", i+1, posUpd[i]);
+		setScreenCell(screen, i, 1, " %2d-%s ", sorted[i].pilotNumber, getDriverShortName(sorted[i].pilotNumber));
 		if (race) {
 			char totalTime[12];
 			carTime2HMS(totalTime,sorted[i].totalTime);
 
-			printf("\033[%d;%dH│ %2d %s │ %2d-%s │ %2d (S%d) │ %11s │ %s%7s\033[0m │ %s%7s\033[0m │  %s%7s\033[27m │ %s%7s\033[27m │ %s%7s\033[27m │ %s%7s\033[27m │  %d  │",
-				4+i, w.ws_col-108, i+1, posUpd[i],
-				sorted[i].pilotNumber, getDriverShortName(sorted[i].pilotNumber), sorted[i].distance / 3, (sorted[i].distance % 3)+1,
-				totalTime,
-				crashedIndex[i] ? "\033[31m":"", differences[i], crashedIndex[i] ? "\033[31m":"", differences1st[i],
-				i==indexBestLap && ctBestLap.seconds != 9999 ? "\033[7m" : "", bestLap,
-				i==indexBestSection[0] && ctBestSection[0].seconds != 99 ? "\033[7m" : "", bestS1,
-				i==indexBestSection[1] && ctBestSection[1].seconds != 99 ? "\033[7m" : "", bestS2,
-				i==indexBestSection[2] && ctBestSection[2].seconds != 99 ? "\033[7m" : "", bestS3,
-				sorted[i].pitStopCount
-			);
+			setScreenCell(screen, i, 2, " %2d (S%d) ", sorted[i].distance / 3, (sorted[i].distance % 3)+1);
+			setScreenCell(screen, i, 3, " %11s ", totalTime);
+			setScreenCell(screen, i, 4, " %s%7s\033[0m ", crashedIndex[i] ? "\033[31m":"", differences[i]);
+			setScreenCell(screen, i, 5, " %s%7s\033[0m ", crashedIndex[i] ? "\033[31m":"", differences1st[i]);
+			setScreenCell(screen, i, 6, "  %s%7s\033[27m ", i==indexBestLap && ctBestLap != CAR_TIME_NONE ? "\033[7m" : "", bestLap);
+			setScreenCell(screen, i, 7, " %s%7s\033[27m ", i==indexBestSection[0] && ctBestSection[0] != CAR_TIME_NONE ? "\033[7m" : "", bestS1);
+			setScreenCell(screen, i, 8, " %s%7s\033[27m ", i==indexBestSection[1] && ctBestSection[1] != CAR_TIME_NONE ? "\033[7m" : "", bestS2);
+			setScreenCell(screen, i, 9, " %s%7s\033[27m ", i==indexBestSection[2] && ctBestSection[2] != CAR_TIME_NONE ? "\033[7m" : "", bestS3);
+			setScreenCell(screen, i, 10, "  %d  ", sorted[i].pitStopCount);
 		} else {
-			printf("\033[%d;%dH│ %2d %s │ %2d-%s │ %s%8s\033[0m │  %s%7s\033[27m │ %s%7s\033[27m │ %s%7s\033[27m │ %s%7s\033[27m │",
-				4+i, w.ws_col-68,
-				i+1, posUpd[i],
-				sorted[i].pilotNumber, getDriverShortName(sorted[i].pilotNumber),
+			setScreenCell(screen, i, 2, " %s%8s\033[0m ",
 				crashedIndex[i] ? "\033[31m": sorted[i].inStand ? "\033[36m" : "\033[32m",
-				crashedIndex[i] ? "--OUT--": sorted[i].inStand ? "IN STAND" : "RUNNING",
-				i==indexBestLap && ctBestLap.seconds != 9999 ? "\033[7m" : "", bestLap,
-				i==indexBestSection[0] && ctBestSection[0].seconds != 99 ? "\033[7m" : "", bestS1,
-				i==indexBestSection[1] && ctBestSection[1].seconds != 99 ? "\033[7m" : "", bestS2,
-				i==indexBestSection[2] && ctBestSection[2].seconds != 99 ? "\033[7m" : "", bestS3
-			);
+				crashedIndex[i] ? "--OUT--": sorted[i].inStand ? "IN STAND" : "RUNNING");
+			setScreenCell(screen, i, 3, "  %s%7s\033[27m ", i==indexBestLap && ctBestLap != CAR_TIME_NONE ? "\033[7m" : "", bestLap);
+			setScreenCell(screen, i, 4, " %s%7s\033[27m ", i==indexBestSection[0] && ctBestSection[0] != CAR_TIME_NONE ? "\033[7m" : "", bestS1);
+			setScreenCell(screen, i, 5, " %s%7s\033[27m ", i==indexBestSection[1] && ctBestSection[1] != CAR_TIME_NONE ? "\033[7m" : "", bestS2);
+			setScreenCell(screen, i, 6, " %s%7s\033[27m ", i==indexBestSection[2] && ctBestSection[2] != CAR_TIME_NONE ? "\033[7m" : "", bestS3);
 		}
 	}
-	if (race) {
-		printf("\033[%d;%dH%s", 4+MAX_PILOT, w.ws_col-108, "└──────┴────────┴─────────┴─────────────┴─────────┴─────────┴──────────┴─────────┴─────────┴─────────┴─────┘");
-	} else {
-		printf("\033[%d;%dH%s", 4+MAX_PILOT, w.ws_col-68, "└──────┴────────┴──────────┴──────────┴─────────┴─────────┴─────────┘");
-	}
-	printf("\033[u");
-	fflush(stdout);
+
+	drawScreenFrame(screen, race ? raceBorders : qualificationBorders);
 }
 
-void screenManager(enum RacePhase phase, int pilotRunning) {
-	CarStat carStatsPrevious[MAX_PILOT];
-	CarStat carStats[MAX_PILOT];
+// empty screen buffer (the 1st frame will be drawn completely)
+void initScreenBuffer(ScreenBuffer* screen) {
+	memset(screen, 0, sizeof(ScreenBuffer));
+	screen->redraw = true;
+}
 
-	// Get at least once the data (for comparison)
-	readSharedMemoryData(carStatsPrevious, CAR_STATS);
+void freeScreenBuffer(ScreenBuffer* screen) {
+	free(screen->cells);
+	free(screen->previous);
+	free(screen->sources);
+	free(screen->output);
+	free(screen->sorted);
+	free(screen->positionUpdates);
+	free(screen->differences);
+	free(screen->differences1st);
+	free(screen->crashed);
+	initScreenBuffer(screen);
+}
 
-	// race or qualification ?
-	bool race = (phase == RACE) || (phase == SPRINT);
+// set the size and position of the table, the whole table is drawn again if they changed
+// widths = number of characters displayed in each cell (columns elements)
+void resizeScreenBuffer(ScreenBuffer* screen, int rows, int columns, int left, const int* widths) {
+	if (rows == screen->rows && columns == screen->columns && left == screen->left && widths == screen->widths) {
+		return;
+	}
+	free(screen->cells);
+	free(screen->previous);
+	free(screen->sources);
+	screen->cells = calloc(rows * columns, sizeof(ScreenCell));
+	screen->previous = calloc(rows * columns, sizeof(ScreenCell));
+	screen->sources = calloc(rows, sizeof(ScreenRowSource));
+	if (!screen->cells || !screen->previous || !screen->sources) {
+		perror("Unable to allocate the screen buffer");
+		exit(1);
+	}
+	screen->rows = rows;
+	screen->columns = columns;
+	screen->left = left;
+	screen->widths = widths;
+	screen->redraw = true;
+}
 
-	while (getRunningCars() > 0) {
-		// read data
-		readSharedMemoryData(carStats, CAR_STATS);
-		// update display
-		displayData(carStats, carStatsPrevious, race, pilotRunning);
-		// copy carStats to carStatsPrevious
-		memcpy(carStatsPrevious, carStats, sizeof(CarStat)*MAX_PILOT);
-		// wait 1 seconds
-		millisWait(1000);
+// if the data of row did not change since the previous frame, copy its cells from the previous frame and return true
+// otherwise keep the new data and return false (the cells of the row have to be set)
+bool reuseScreenRow(ScreenBuffer* screen, int row, const ScreenRowSource* source) {
+	ScreenCell* cells = &screen->cells[row * screen->columns];
+	if (!screen->redraw && memcmp(&screen->sources[row], source, sizeof(ScreenRowSource)) == 0) {
+		memcpy(cells, &screen->previous[row * screen->columns], sizeof(ScreenCell) * screen->columns);
+		return true;
 	}
+	memcpy(&screen->sources[row], source, sizeof(ScreenRowSource));
+	return false;
+}
 
-	// No more car running, do a last update and display
-	// read data and display them
-	millisWait(1000);
-	readSharedMemoryData(carStats, CAR_STATS);
-	displayData(carStats, carStatsPrevious, race, pilotRunning);
+// set the text of a cell (printf format) in the frame being built
+void setScreenCell(ScreenBuffer* screen, int row, int column, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	vsnprintf(screen->cells[row * screen->columns + column].text, SCREEN_CELL_SIZE, format, args);
+	va_end(args);
 }
 
-void displayLogo() {
+// add text (printf format) to the output of the frame
+void appendScreenOutput(ScreenBuffer* screen, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(screen->output + screen->outputLength, screen->outputSize - screen->outputLength, format, args);
+	va_end(args);
+
+	if (screen->outputLength + length >= screen->outputSize) {
+		// not enough space: make the buffer bigger and format again
+		screen->outputSize = (screen->outputLength + length + 1) * 2;
+		screen->output = realloc(screen->output, screen->outputSize);
+		if (!screen->output) {
+			perror("Unable to allocate the screen output");
+			exit(1);
+		}
+		va_start(args, format);
+		vsnprintf(screen->output + screen->outputLength, screen->outputSize - screen->outputLength, format, args);
+		va_end(args);
+	}
+	screen->outputLength += length;
+}
+
+// send the frame to the terminal: only the cells that are different from the previous frame (everything if redraw)
+// all the escape sequences are sent with a single write()
+// borders = top, titles, line below the titles and bottom of the table
+void drawScreenFrame(ScreenBuffer* screen, const char* const* borders) {
+	// print using ANSI ESCAPE sequence
+	// \033[s = save current cursor position
+	// \033[u = restore cursor to previously saved position
+	// \033[{line};{column}H = move cursor to position {col}, {column}
+	screen->outputLength = 0;
+	if (screen->outputSize == 0) {
+		screen->outputSize = 4096;
+		screen->output = malloc(screen->outputSize);
+		if (!screen->output) {
+			perror("Unable to allocate the screen output");
+			exit(1);
+		}
+	}
+	appendScreenOutput(screen, "\033[s");
+
+	if (screen->redraw) {
+		// whole table: borders and all the rows
+		for (int i = 0; i < 3; i++) {
+			appendScreenOutput(screen, "\033[%d;%dH%s", 1+i, screen->left, borders[i]);
+		}
+		for (int row = 0; row < screen->rows; row++) {
+			appendScreenOutput(screen, "\033[%d;%dH│", 4+row, screen->left);
+			for (int column = 0; column < screen->columns; column++) {
+				appendScreenOutput(screen, "%s│", screen->cells[row * screen->columns + column].text);
+			}
+		}
+		appendScreenOutput(screen, "\033[%d;%dH%s", 4+screen->rows, screen->left, borders[3]);
+		screen->redraw = false;
+	} else {
+		// only the cells that changed
+		for (int row = 0; row < screen->rows; row++) {
+			int x = screen->left + 1;
+			for (int column = 0; column < screen->columns; column++) {
+				int cell = row * screen->columns + column;
+				if (strcmp(screen->cells[cell].text, screen->previous[cell].text) != 0) {
+					appendScreenOutput(screen, "\033[%d;%dH%s", 4+row, x, screen->cells[cell].text);
+				}
+				x += screen->widths[column] + 1;
+			}
+		}
+	}
+	appendScreenOutput(screen, "\033[u");
+
+	// the frame on the screen is now this one
+	ScreenCell* previous = screen->previous;
+	screen->previous = screen->cells;
+	screen->cells = previous;
+
+	// text already printed with printf must be sent first
+	fflush(stdout);
+	size_t written = 0;
+	while (written < screen->outputLength) {
+		ssize_t result = write(STDOUT_FILENO, screen->output + written, screen->outputLength - written);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += result;
+	}
+	// no shared memory during a replay (see runReplay)
+	if (sharedMemory) {
+		sharedMemory->screenFrames++;
+		sharedMemory->screenBytes += written;
+	}
+}
+
+void screenManager(enum RacePhase phase, int pilotRunning) {
+	CarStat* carStats = malloc(pilotCount * sizeof(CarStat));
+	int* ranking = malloc(pilotCount * sizeof(int));
+	int* previousPosition = malloc(pilotCount * sizeof(int));
+	if (!carStats || !ranking || !previousPosition) {
+		perror("Unable to allocate the screen manager");
+		exit(1);
+	}
+
+	// Get at least once the data (for comparison)
+	readCarStats(carStats, ranking);
+	for (int i=0;i<pilotCount;i++) {
+		previousPosition[ranking[i]] = i;
+	}
+
+	// race or qualification ?
+	bool race = (phase == RACE) || (phase == SPRINT);
+
+	ScreenBuffer screen;
+	initScreenBuffer(&screen);
+	long long minFrameInterval = 1000000000LL / options.fps;
+	unsigned int drawnGeneration = 0;
+	bool firstFrame = true;
+	bool positionsChanged = false;
+	long long lastFrame = 0;
+	long long lastPositions = getMonotonicNanos();
+
+	// a frame is drawn when the controller published a new generation of the carStats,
+	// but not more than options.fps frames per second; without any change, wake up once per second
+	// (the position changes (↑, ↓) are computed every second)
+	bool done = false;
+	while (!done) {
+		// read controllerDone before the generation: the last frame has the final data
+		done = atomic_load_explicit(&sharedMemory->controllerDone, memory_order_acquire);
+		unsigned int generation = atomic_load_explicit(&sharedMemory->carStatsGeneration, memory_order_acquire);
+		long long now = getMonotonicNanos();
+
+		if (now - lastPositions >= SCREEN_MAX_FRAME_INTERVAL) {
+			// keep the positions of the last display (to show the position changes during the next second)
+			for (int i=0;i<pilotCount;i++) {
+				if (previousPosition[ranking[i]] != i) {
+					previousPosition[ranking[i]] = i;
+					positionsChanged = true;
+				}
+			}
+			lastPositions = now;
+		}
+
+		if (firstFrame || positionsChanged || generation != drawnGeneration) {
+			// read data (the generation drawn is the one of the data read, a commit may have been done since generation was loaded)
+			drawnGeneration = readCarStats(carStats, ranking);
+			// update display
+			displayData(&screen, carStats, ranking, previousPosition, race, pilotRunning);
+			firstFrame = false;
+			positionsChanged = false;
+			lastFrame = now;
+		} else {
+			sharedMemory->screenSkippedFrames++;
+		}
+		if (done) {
+			break;
+		}
+
+		// frame rate limit
+		deadlineWait(lastFrame + minFrameInterval);
+
+		// sleep until the next commit of the controller (or 1 second)
+		while (sem_trywait(&sharedMemory->screenWakeup) == 0);
+		if (atomic_load_explicit(&sharedMemory->carStatsGeneration, memory_order_acquire) == drawnGeneration
+			&& !atomic_load_explicit(&sharedMemory->controllerDone, memory_order_acquire)) {
+			long long timeout = lastPositions + SCREEN_MAX_FRAME_INTERVAL - getMonotonicNanos();
+			if (timeout > 0) {
+				// sem_timedwait uses an absolute CLOCK_REALTIME time
+				struct timespec deadline;
+				clock_gettime(CLOCK_REALTIME, &deadline);
+				deadline.tv_sec += (deadline.tv_nsec + timeout) / 1000000000LL;
+				deadline.tv_nsec = (deadline.tv_nsec + timeout) % 1000000000LL;
+				while (sem_timedwait(&sharedMemory->screenWakeup, &deadline) == -1 && errno == EINTR);
+			}
+		}
+		sharedMemory->screenWakeups++;
+	}
+
+	freeScreenBuffer(&screen);
+	free(carStats);
+	free(ranking);
+	free(previousPosition);
+
+	struct timespec cpuTime;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+	sharedMemory->screenCpuNanos = cpuTime.tv_sec * 1000000000LL + cpuTime.tv_nsec;
+}
+
+void displayLogo() {
 	// get screen size
 	struct winsize w;
 	ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
@@ -964,7 +2092,7 @@ void displayLogo() {
 }
 
 char* getDriverShortName(int id) {
-	for(int i=0;i<MAX_PILOT;i++) {
+	for(int i=0;i<pilotCount;i++) {
 		if (drivers[i].id == id) {
 			return drivers[i].shortName;
 		}
@@ -974,11 +2102,58 @@ char* getDriverShortName(int id) {
 
 // ---------------------------------------------------------------------------------
 // Controller main function
-void controller(int trackNumber, int phase, int pilotRunning) {
+void controller(int trackNumber, int phase, int pilotRunning, uint64_t seed) {
 	// determine number of lap
 	int maxLap=getTrackLap(trackNumber, phase);
-	CarTimeAndStatus carTimeAndStatuses[MAX_PILOT];
-	CarStat carStats[MAX_PILOT];
+	CarTimeAndStatus carTimeAndStatus;
+	bool raceOver = false;
+	bool race = (phase == RACE) || (phase == SPRINT);
+
+	// the arrays sized by the grid are allocated once for the session (the controller is a thread with --threads)
+	// running order, only written by the controller: it is updated 1 car at a time and published with the carStats
+	// keys = sort key of each car (see getCarSortKey), all the cars are equal at the start
+	// events = events folded for each car, sawRaceOver = its last event was computed after the end of the race (for the checkpoints)
+	// dirtyColumns and consumed = changes of an iteration of the loop
+	CarStat* carStats = malloc(pilotCount * sizeof(CarStat));
+	int* ranking = malloc(pilotCount * sizeof(int));
+	int* position = malloc(pilotCount * sizeof(int));
+	uint64_t* keys = malloc(pilotCount * sizeof(uint64_t));
+	long long* events = calloc(pilotRunning, sizeof(long long));
+	bool* sawRaceOver = calloc(pilotRunning, sizeof(bool));
+	unsigned int* dirtyColumns = malloc(pilotCount * sizeof(unsigned int));
+	int* consumed = malloc(pilotCount * sizeof(int));
+	if (!carStats || !ranking || !position || !keys || !events || !sawRaceOver || !dirtyColumns || !consumed) {
+		perror("Unable to allocate the controller");
+		exit(1);
+	}
+	initRanking(ranking, position, pilotCount);
+
+	// only the controller writes the carStats: it reads them once and works on its own copy,
+	// each commit only writes the columns changed by the events (see getChangedColumns)
+	readSharedMemoryData(carStats,CAR_STATS);
+	for (int i = 0; i < pilotCount; i++) {
+		keys[i] = getCarSortKey(&carStats[i], race);
+	}
+
+	int sessionMillis = 0;
+	const Checkpoint* resume = resumeCheckpoint.header ? &resumeCheckpoint : NULL;
+	if (resume) {
+		// continue the session from the checkpoint (the CarStats are already in shared memory, see main)
+		for (int i = 0; i < pilotCount; i++) {
+			ranking[i] = resume->ranking[i];
+			position[ranking[i]] = i;
+		}
+		for (int i = 0; i < pilotRunning; i++) {
+			events[i] = resume->cars[i].events;
+			sawRaceOver[i] = resume->cars[i].sawRaceOver;
+		}
+		raceOver = resume->header->raceOver;
+		sessionMillis = resume->header->sessionMillis;
+	}
+
+	// every event is saved in the journal (written by a background thread), with a checkpoint every few seconds
+	Journal* journal = openJournal(trackNumber, phase, maxLap, carStats, pilotRunning, seed, resume);
+	long long nextCheckpoint = getMonotonicNanos() + options.checkpointSeconds * 1000000000LL;
 
 	bool controllerStop = false;
 	// infinite loop (will be stopped when all cars are stopped)
@@ -986,13 +2161,10 @@ void controller(int trackNumber, int phase, int pilotRunning) {
 		// check if still car simulator running
 		controllerStop = (getRunningCars() == 0);
 
-		// read CarTimeAndStatuses
-		readSharedMemoryData(carTimeAndStatuses,CAR_TIME_AND_STATUSES);
-
 		// Check if any data from car simulator to proceed
 		bool processPending=false;
 		for (int i = 0; i < pilotRunning; i++) {
-			if (!carTimeAndStatuses[i].processed) {
+			if (getCarEventQueueDepth(i) > 0) {
 				processPending=true;
 				break;
 			}
@@ -1002,104 +2174,441 @@ void controller(int trackNumber, int phase, int pilotRunning) {
 		controllerStop &= !processPending;
 
 		if (!processPending) {
-			// Nothing to do, will wait .1 second and check again
-			millisWait(100);
+			if (!controllerStop) {
+				// Nothing to do, sleep until a car simulator publishes an event or stops
+				sem_wait(&sharedMemory->dataReady);
+				sharedMemory->controllerWakeups++;
+			}
 			continue;
 		}
 
-		// read CarStat (we have update to do)
-		readSharedMemoryData(carStats,CAR_STATS);
-
-		// Check all records
+		// Check all rings, all the updates of this iteration are published by a single commit
+		memset(dirtyColumns, 0, pilotCount * sizeof(unsigned int));
+		memset(consumed, 0, pilotCount * sizeof(int));
+		// positions changed in the ranking (none if rankingFirst > rankingLast)
+		int rankingFirst = pilotCount;
+		int rankingLast = -1;
+		bool raceOverReached = false;
 		for (int i = 0; i < pilotRunning; i++) {
-			// processed == 0 => data still to be processed
-			if (carTimeAndStatuses[i].processed == false) {
-				if (carTimeAndStatuses[i].carStatus == CRASHED) {
-					// car crashed => no time to proceed
-					carStats[i].crashed=true;
-				} else if (carTimeAndStatuses[i].carStatus == WAIT_IN_STAND) {
-					// car in stand => no time to proceed
-					carStats[i].inStand=true;
-				} else {
-					// car running (so no more in stand)
-					carStats[i].inStand=false;
+			// read all events waiting in the ring of the car
+			while (receiveDataFromCar(i, consumed[i], &carTimeAndStatus)) {
+				consumed[i]++;
+				CarStat before = carStats[i];
+
+				// keep track of the time between publication and processing
+				addLatency(&sharedMemory->eventLatency, getMonotonicNanos() - carTimeAndStatus.sentAt);
+				journalEvent(journal, i, carStats[i].distance % 3, &carTimeAndStatus);
+				events[i]++;
+				sawRaceOver[i] = carTimeAndStatus.raceOver;
+				sessionMillis = carTimeAndStatus.sessionMillis > sessionMillis ? carTimeAndStatus.sessionMillis : sessionMillis;
+
+				if (foldCarEvent(&carStats[i], &carTimeAndStatus, phase, maxLap) && !raceOver) {
+					// race is over, all other simulator must stop
+					raceOver = true;
+					raceOverReached = true;
+				}
+				dirtyColumns[i] |= getChangedColumns(&before, &carStats[i]);
+
+				keys[i] = getCarSortKey(&carStats[i], race);
+				int from = position[i];
+				int to = moveCarInRanking(ranking, position, keys, i, pilotRunning);
+				if (from != to) {
+					// the cars between from and to moved by 1 position
+					int first = from < to ? from : to;
+					int last = from < to ? to : from;
+					rankingFirst = first < rankingFirst ? first : rankingFirst;
+					rankingLast = last > rankingLast ? last : rankingLast;
+				}
+			}
+		}
 
-					// did a pit stop ?
-					if (carTimeAndStatuses[i].carStatus == PITSTOP) {
-						carStats[i].pitStopCount++;
-					}
+		// publish CarStats and ranking (for screen Manager), race over flag and give the slots back to the car simulators
+		commitControllerUpdates(carStats, ranking, rankingFirst, rankingLast, dirtyColumns, consumed, pilotRunning, raceOverReached);
 
-					// determine the section
-					// 0 -> 1st section, 1 = 2nd section, 2 = 3rd section
-					int sectionNumber = (carStats[i].distance % 3);
+		if (journal && options.checkpointSeconds > 0 && getMonotonicNanos() >= nextCheckpoint) {
+			// copy the state of the session, the writer thread saves it (the car simulators are not stopped)
+			takeCheckpoint(journal, carStats, ranking, events, sawRaceOver, raceOver, sessionMillis);
+			nextCheckpoint = getMonotonicNanos() + options.checkpointSeconds * 1000000000LL;
+		}
+	}
 
-					// increment distance (counting number of section done, number of lap distance/3)
-					carStats[i].distance++;
+	if (journal) {
+		// write the last events (the report is displayed by main)
+		closeJournal(journal);
+		sharedMemory->journalEvents = journal->header.recordCount;
+		sharedMemory->journalDropped = journal->header.droppedCount;
+		sharedMemory->journalWrites = journal->writes;
+		sharedMemory->checkpoints = journal->checkpoints;
+		sharedMemory->checkpointNanos = journal->checkpointNanos;
+		free(journal);
+	}
+	free(carStats);
+	free(ranking);
+	free(position);
+	free(keys);
+	free(events);
+	free(sawRaceOver);
+	free(dirtyColumns);
+	free(consumed);
+
+	// all events are published: the screen manager can draw the last frame and stop
+	atomic_store_explicit(&sharedMemory->controllerDone, true, memory_order_release);
+	sem_post(&sharedMemory->screenWakeup);
+}
 
-					// save section timing
-					carStats[i].currentSectionTime[sectionNumber].seconds=carTimeAndStatuses[i].sectionTime.seconds;
-					carStats[i].currentSectionTime[sectionNumber].milliseconds=carTimeAndStatuses[i].sectionTime.milliseconds;
+// add the event sent by a car simulator to the data of the car
+// return true if the car just reached the finish line (race or sprint)
+bool foldCarEvent(CarStat* carStat, const CarTimeAndStatus* carTimeAndStatus, enum RacePhase phase, int maxLap) {
+	if (carTimeAndStatus->carStatus == CRASHED) {
+		// car crashed => no time to proceed
+		carStat->crashed=true;
+	} else if (carTimeAndStatus->carStatus == WAIT_IN_STAND) {
+		// car in stand => no time to proceed
+		carStat->inStand=true;
+	} else {
+		// car running (so no more in stand)
+		carStat->inStand=false;
 
-					// Compare with best section
-					if (compareCarTime(carStats[i].currentSectionTime[sectionNumber], carStats[i].bestSectionTime[sectionNumber]) < 0) {
-						// new best section time
-						carStats[i].bestSectionTime[sectionNumber].seconds = carStats[i].currentSectionTime[sectionNumber].seconds;
-						carStats[i].bestSectionTime[sectionNumber].milliseconds = carStats[i].currentSectionTime[sectionNumber].milliseconds;
-					}
+		// did a pit stop ?
+		if (carTimeAndStatus->carStatus == PITSTOP) {
+			carStat->pitStopCount++;
+		}
 
-					// if 3rd section, compute lap time
-					if (sectionNumber==2) {
-						// lapTime = S1 + S2 + S3
-						CarTime lapTime;
-						lapTime.seconds = carStats[i].currentSectionTime[0].seconds;
-						lapTime.milliseconds = carStats[i].currentSectionTime[0].milliseconds;
-						combineCarTime(&lapTime,carStats[i].currentSectionTime[1]);
-						combineCarTime(&lapTime,carStats[i].currentSectionTime[2]);
-
-						// check if new best lapTime
-						if (compareCarTime(lapTime, carStats[i].bestLap) < 0) {
-							carStats[i].bestLap.seconds = lapTime.seconds;
-							carStats[i].bestLap.milliseconds = lapTime.milliseconds;
-						}
+		// determine the section
+		// 0 -> 1st section, 1 = 2nd section, 2 = 3rd section
+		int sectionNumber = (carStat->distance % 3);
 
-						// Update total time
-						combineCarTime(&(carStats[i].totalTime), lapTime);
-					}
+		// increment distance (counting number of section done, number of lap distance/3)
+		carStat->distance++;
 
-					// check if race is over
-					if (phase == SPRINT || phase == RACE) {
-						if (carStats[i].distance/3 == maxLap) {
-							// race is over, all other simulator must stop
-							setRaceAsOver();
-						}
-					}
-				}
+		// save section timing
+		carStat->currentSectionTime[sectionNumber]=carTimeAndStatus->sectionTime;
+
+		// Compare with best section
+		if (carStat->currentSectionTime[sectionNumber] < carStat->bestSectionTime[sectionNumber]) {
+			// new best section time
+			carStat->bestSectionTime[sectionNumber] = carStat->currentSectionTime[sectionNumber];
+		}
+
+		// if 3rd section, compute lap time
+		if (sectionNumber==2) {
+			// lapTime = S1 + S2 + S3
+			CarTime lapTime = carStat->currentSectionTime[0] + carStat->currentSectionTime[1] + carStat->currentSectionTime[2];
+
+			// check if new best lapTime
+			if (lapTime < carStat->bestLap) {
+				carStat->bestLap = lapTime;
+			}
+
+			// Update total time
+			carStat->totalTime += lapTime;
+		}
+
+		// check if race is over
+		if (phase == SPRINT || phase == RACE) {
+			if (carStat->distance/3 == maxLap) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// best lap and sections time are set to CAR_TIME_NONE (no time yet)
+void initCarStatTimes(CarStat* carStat) {
+	carStat->bestLap = CAR_TIME_NONE;
+	for (int j=0;j<3;j++) {
+		carStat->bestSectionTime[j] = CAR_TIME_NONE;
+	}
+}
+
+// running order at the start of a session: all the cars are equal, so they are ranked in the order of the grid
+// ranking[position] = car, position[car] = position (may be NULL)
+void initRanking(int* ranking, int* position, int carCount) {
+	for (int i = 0; i < carCount; i++) {
+		ranking[i] = i;
+		if (position) {
+			position[i] = i;
+		}
+	}
+}
+
+// put car back at its place in the running order after an update of its sort key (keys[car], see getCarSortKey)
+// the other cars did not change, so the ranking is sorted except for this car: it only has to move up or down
+// (usually 0 or 1 position), instead of sorting all the cars again
+// return the new position of the car
+int moveCarInRanking(int* ranking, int* position, const uint64_t* keys, int car, int carCount) {
+	int pos = position[car];
+
+	// better than the car in front of it => overtake
+	while (pos > 0 && keys[car] < keys[ranking[pos-1]]) {
+		ranking[pos] = ranking[pos-1];
+		position[ranking[pos]] = pos;
+		pos--;
+	}
+	// worse than the car behind it (crashed) => lose position
+	while (pos < carCount-1 && keys[ranking[pos+1]] < keys[car]) {
+		ranking[pos] = ranking[pos+1];
+		position[ranking[pos]] = pos;
+		pos++;
+	}
+	ranking[pos] = car;
+	position[car] = pos;
+	return pos;
+}
+
+// -------------------------------------------------------------
+// Sort keys: the order of compareCarStatRace/compareCarStatQualification packed in 1 integer per car,
+// so cars are compared with 1 integer comparison and large grids are sorted with a radix sort
+
+// sort key of a car: smaller key = better position, same key = same position for the comparator
+// race: crashed (bit 63), then 2^20-1 - distance (20 bits), then totalTime (43 bits, more than 100 days)
+// qualification: bestLap (bits 32 to 61, CAR_TIME_NONE fits), then S1+S2+S3 (32 bits)
+uint64_t getCarSortKey(const CarStat* carStat, bool race) {
+	if (race) {
+		uint64_t distance = carStat->distance < (1 << 20) ? (uint64_t)carStat->distance : (1 << 20) - 1;
+		uint64_t totalTime = carStat->totalTime < (1LL << 43) ? (uint64_t)carStat->totalTime : (1ULL << 43) - 1;
+		return ((uint64_t)carStat->crashed << 63) | ((((1 << 20) - 1) - distance) << 43) | totalTime;
+	}
+
+	CarTime sectionSum = carStat->bestSectionTime[0] + carStat->bestSectionTime[1] + carStat->bestSectionTime[2];
+	uint64_t bestLap = carStat->bestLap < (1LL << 30) ? (uint64_t)carStat->bestLap : (1ULL << 30) - 1;
+	uint64_t sections = sectionSum < (1LL << 32) ? (uint64_t)sectionSum : (1ULL << 32) - 1;
+	return (bestLap << 32) | sections;
+}
+
+// sort ranking (carCount indexes of cars) by keys[car], the cars with the same key stay in the same order (stable sort)
+// LSD radix sort, 1 byte per pass, the passes where all keys have the same byte are skipped
+// (insertion sort below RADIX_SORT_MIN cars)
+void sortCarsByKey(const uint64_t* keys, int* ranking, int carCount) {
+	if (carCount < RADIX_SORT_MIN) {
+		for (int i = 1; i < carCount; i++) {
+			int car = ranking[i];
+			int j = i;
+			while (j > 0 && keys[car] < keys[ranking[j-1]]) {
+				ranking[j] = ranking[j-1];
+				j--;
+			}
+			ranking[j] = car;
+		}
+		return;
+	}
+
+	// sort (key, car) pairs: the keys are read sequentially in each pass
+	uint64_t* sortedKeys = malloc(sizeof(uint64_t) * carCount * 2);
+	int* sortedCars = malloc(sizeof(int) * carCount * 2);
+	if (!sortedKeys || !sortedCars) {
+		perror("Unable to allocate the sort buffers");
+		exit(1);
+	}
+	uint64_t* keysFrom = sortedKeys;
+	uint64_t* keysTo = sortedKeys + carCount;
+	int* carsFrom = sortedCars;
+	int* carsTo = sortedCars + carCount;
+
+	// count the bytes of all the passes at once
+	int counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (int i = 0; i < carCount; i++) {
+		keysFrom[i] = keys[ranking[i]];
+		carsFrom[i] = ranking[i];
+		for (int pass = 0; pass < 8; pass++) {
+			counts[pass][(keysFrom[i] >> (pass * 8)) & 0xff]++;
+		}
+	}
+
+	for (int pass = 0; pass < 8; pass++) {
+		int shift = pass * 8;
+		if (counts[pass][(keysFrom[0] >> shift) & 0xff] == carCount) {
+			// same byte for all keys, nothing to do
+			continue;
+		}
+
+		// start of each byte value in the destination
+		int offset = 0;
+		for (int value = 0; value < 256; value++) {
+			int count = counts[pass][value];
+			counts[pass][value] = offset;
+			offset += count;
+		}
+
+		for (int i = 0; i < carCount; i++) {
+			int destination = counts[pass][(keysFrom[i] >> shift) & 0xff]++;
+			keysTo[destination] = keysFrom[i];
+			carsTo[destination] = carsFrom[i];
+		}
+
+		uint64_t* keysSwap = keysFrom;
+		keysFrom = keysTo;
+		keysTo = keysSwap;
+		int* carsSwap = carsFrom;
+		carsFrom = carsTo;
+		carsTo = carsSwap;
+	}
+
+	memcpy(ranking, carsFrom, sizeof(int) * carCount);
+	free(sortedKeys);
+	free(sortedCars);
+}
+
+// compute the running order of carStats (same order as qsort with compareCarStatRace/compareCarStatQualification,
+// the cars with the same position are in the order of carStats)
+void rankCars(const CarStat* carStats, int* ranking, int carCount, bool race) {
+	uint64_t* keys = malloc(sizeof(uint64_t) * carCount);
+	if (!keys) {
+		perror("Unable to allocate the sort keys");
+		exit(1);
+	}
+	for (int i = 0; i < carCount; i++) {
+		keys[i] = getCarSortKey(&carStats[i], race);
+	}
+	initRanking(ranking, NULL, carCount);
+	sortCarsByKey(keys, ranking, carCount);
+	free(keys);
+}
+
+// random grid in the middle of a race or a qualification
+void fillRandomCarStats(CarStat* carStats, int carCount, Rng* rng) {
+	for (int i = 0; i < carCount; i++) {
+		carStats[i].pilotNumber = i+1;
+		carStats[i].crashed = rngInt(rng, 50) == 0;
+		carStats[i].distance = rngInt(rng, 60);
+		carStats[i].totalTime = carStats[i].distance * 25 * CAR_TIME_SECOND + rngInt(rng, 60000) * CAR_TIME_MILLISECOND;
+		initCarStatTimes(&carStats[i]);
+		if (rngInt(rng, 10) > 0) {
+			for (int j = 0; j < 3; j++) {
+				carStats[i].bestSectionTime[j] = 25 * CAR_TIME_SECOND + rngInt(rng, 5000) * CAR_TIME_MILLISECOND;
+			}
+			carStats[i].bestLap = carStats[i].bestSectionTime[0] + carStats[i].bestSectionTime[1] + carStats[i].bestSectionTime[2]
+				+ rngInt(rng, 2000) * CAR_TIME_MILLISECOND;
+		}
+	}
+}
+
+// sorted = carStats sorted by qsort, ranking = order given by rankCars
+// qsort is not stable, so only check that each position has the same value
+bool sameCarOrder(const CarStat* sorted, const CarStat* carStats, const int* ranking, int carCount, bool race) {
+	for (int i = 0; i < carCount; i++) {
+		int compare = race ? compareCarStatRace(&sorted[i], &carStats[ranking[i]])
+			: compareCarStatQualification(&sorted[i], &carStats[ranking[i]]);
+		if (compare != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// --bench-sort: sort random grids of 20, 1k and 100k cars with qsort (copy of the CarStats + comparator)
+// and with rankCars (sort keys + radix sort), check that the orders are the same and display the time of 1 sort
+// return false if an order is different
+bool benchmarkCarSort() {
+	int sizes[3] = { 20, 1000, 100000 };
+	bool allSame = true;
+	uint64_t seed = nextSessionSeed();
+	Rng rng;
+	rngSeed(&rng, seed, 0);
+
+	printf("Sort of the cars: qsort vs sort keys + radix sort, seed %llu\n", (unsigned long long)seed);
+	for (int s = 0; s < 3; s++) {
+		int carCount = sizes[s];
+		CarStat* carStats = calloc(carCount, sizeof(CarStat));
+		CarStat* sorted = malloc(sizeof(CarStat) * carCount);
+		int* ranking = malloc(sizeof(int) * carCount);
+		if (!carStats || !sorted || !ranking) {
+			perror("Unable to allocate the cars");
+			exit(1);
+		}
+		// about 2M cars sorted by each method
+		int repeat = 2000000 / carCount;
 
-				// Mark CarTimeAndStatus as processed
-				setCarTimeAndStatusAsProcessed(i);
+		for (int race = 1; race >= 0; race--) {
+			fillRandomCarStats(carStats, carCount, &rng);
+
+			long long start = getMonotonicNanos();
+			for (int r = 0; r < repeat; r++) {
+				memcpy(sorted, carStats, sizeof(CarStat) * carCount);
+				qsort(sorted, carCount, sizeof(CarStat), race ? compareCarStatRace : compareCarStatQualification);
+			}
+			long long qsortNanos = (getMonotonicNanos() - start) / repeat;
 
-				// update CarStat (for screen Manager)
-				updateCarStat(carStats[i],i);
+			start = getMonotonicNanos();
+			for (int r = 0; r < repeat; r++) {
+				rankCars(carStats, ranking, carCount, race);
 			}
+			long long radixNanos = (getMonotonicNanos() - start) / repeat;
+
+			bool same = sameCarOrder(sorted, carStats, ranking, carCount, race);
+			printf(" %-13s %6d cars: qsort %10.3f us, keys + radix %10.3f us, %5.2fx, order %s\n",
+				race ? "race" : "qualification", carCount, qsortNanos / 1000.0, radixNanos / 1000.0,
+				(double)qsortNanos / radixNanos, same ? "identical" : "DIFFERENT");
+			allSame &= same;
 		}
+
+		free(carStats);
+		free(sorted);
+		free(ranking);
 	}
+	return allSame;
 }
 
 // ---------------------------------------------------------------
 /**
  * Car Simulator functions
- * carSimulator: main car simulator function, determine what to do (qualif, race, ...)
- * carSimulatorRace: do a race or sprint
- * carSimulatorQualification: do qualification or free practise
+ * carSimulator: main car simulator function, send the events of the car to the controller
+ * initCarSimulator: determine what to do (qualif, race, ...) and prepare the state of the car
+ * carSimulatorNext: compute the next event of the car and the time to wait after it
+ * carSimulatorRaceNext: next event of a race or sprint
+ * carSimulatorQualificationNext: next event of a qualification or free practise
 */
 
 // id = car number
 // delay = time lost due to start of the race (1st car has no delay, 2nd .5s delay, ...)
 // trackNumber = to determine which track we do
 // racePhase = determine phase (qualification, sprint, race, ...)
-void carSimulator(int id, CarTime delay, int trackNumber, enum RacePhase phase) {
-	// initialize randomizer with time+id, so that all car are different :-)
-	srand(time(NULL)+id);
+// seed = seed of the session (each car has its own random stream)
+void carSimulator(int id, CarTime delay, int trackNumber, enum RacePhase phase, uint64_t seed) {
+	CarSimulatorState state;
+	long long virtualMillis = 0;
+	if (resumeCheckpoint.header) {
+		// resumed session: the car continues after its last event folded before the checkpoint
+		state = resumeCheckpoint.cars[id].state;
+		virtualMillis = resumeCheckpoint.cars[id].virtualMillis;
+	} else {
+		initCarSimulator(&state, id, delay, trackNumber, phase, seed);
+	}
+
+	// in case we are not able to immediatly update data, we will wait a few milliseconds, keep track of those waits
+	CarTimeAndStatus carTimeStatus;
+	int waitMillis;
+	// all cars share the same session clock: an event happening at virtualMillis is due at sessionStart + virtualMillis / speed
+	// sleeping until absolute deadlines, the time lost to send data or to wake up is not accumulated
+	CarEventRing* ring = &sharedMemory->carEventRings[id];
+	long long deadline = sharedMemory->sessionStart + virtualMillis * 1000000LL / options.speed;
+	deadlineWait(deadline);
+	while (carSimulatorNext(&state, isRaceOver(), &carTimeStatus, &waitMillis)) {
+		carTimeStatus.sessionMillis = virtualMillis;
+		sendDataToController(id,carTimeStatus);
+
+		if (waitMillis > 0) {
+			// simulate time on track (or in stand), speed is multiplied by options.speed
+			virtualMillis += waitMillis;
+			deadline = sharedMemory->sessionStart + virtualMillis * 1000000LL / options.speed;
+			deadlineWait(deadline);
+			addLatency(&ring->deadlineLateness, getMonotonicNanos() - deadline);
+		}
+	}
+	ring->driftNanos = getMonotonicNanos() - deadline;
+
+	// the car finished practice, qualification, sprint or race
+	decrementRunningCars();
+}
+
+// delay = time lost due to start of the race (1st car has no delay, 2nd .5s delay, ...)
+// id = car number, seed = seed of the session: the random stream of the car depends on both
+void initCarSimulator(CarSimulatorState* state, int id, CarTime delay, int trackNumber, enum RacePhase phase, uint64_t seed) {
+	memset(state, 0, sizeof(CarSimulatorState));
+	rngSeed(&state->rng, seed, id);
 
 	// determine what to do
 	switch (phase) {
@@ -1112,253 +2621,2135 @@ void carSimulator(int id, CarTime delay, int trackNumber, enum RacePhase phase)
 		case SPRINT_QUALIFICATION_1:
 		case SPRINT_QUALIFICATION_2:
 		case SPRINT_QUALIFICATION_3:
-			int time=getQualifTime(trackNumber, phase);
-			carSimulatorQualification(id, time);
+			state->step = QUALIFICATION_IN_STAND;
+			state->maxTime = getQualifTime(trackNumber, phase);
+
+			// determine base section time
+			state->sectionTime = (25 + rngInt(&state->rng, 20)) * CAR_TIME_SECOND; // between 25 and 44 seconds
+			state->sectionTime += rngInt(&state->rng, 1000) * CAR_TIME_MILLISECOND;
 			break;
 		case SPRINT:
 		case RACE:
-			int maxLap=getTrackLap(trackNumber, phase);
-			carSimulatorRace(id, delay, maxLap);
+			state->step = RACE_SECTION;
+			state->maxLap = getTrackLap(trackNumber, phase);
+			state->running = true;
+
+			// determine very 1st section time
+			state->sectionTime = (25 + rngInt(&state->rng, 10)) * CAR_TIME_SECOND; // between 25 and 35 seconds (we will add delay)
+			state->sectionTime += rngInt(&state->rng, 1000) * CAR_TIME_MILLISECOND;
+
+			// add delay (time lost on starting grid), between 0 and 9,5 seconds
+			state->sectionTime += delay;
+
+			// determine pit stop strategy
+			if (state->maxLap < 35 || rngInt(&state->rng, 2) == 0) {
+				// 2 stops
+				state->pitStopLap[0]=state->maxLap/3+rngInt(&state->rng, 11)-5;
+				state->pitStopLap[1]=(state->maxLap/3)*2+rngInt(&state->rng, 11)-5;
+				state->pitStopLap[2]=9999; // no 3rd pit stop
+			} else {
+				// 3 stops
+				state->pitStopLap[0]=state->maxLap/4+rngInt(&state->rng, 11)-5;
+				state->pitStopLap[1]=state->maxLap/2+rngInt(&state->rng, 11)-5;
+				state->pitStopLap[2]=(state->maxLap/4)*3+rngInt(&state->rng, 11)-5;
+			}
 			break;
+		default:
+			state->step = CAR_SIMULATOR_DONE;
 	}
+}
 
-	// the car finished practice, qualification, sprint or race
-	decrementRunningCars();
+// compute the next event of the car (carTimeStatus) and how many milliseconds (real time) it lasts (waitMillis)
+// raceOver = someone already reached finish line
+// return false if the car has finished practice, qualification, sprint or race (no more event)
+bool carSimulatorNext(CarSimulatorState* state, bool raceOver, CarTimeAndStatus* carTimeStatus, int* waitMillis) {
+	carTimeStatus->raceOver = raceOver;
+	if (state->step == RACE_SECTION) {
+		return carSimulatorRaceNext(state, raceOver, carTimeStatus, waitMillis);
+	} else {
+		return carSimulatorQualificationNext(state, carTimeStatus, waitMillis);
+	}
 }
 
 // -----------------------------------------
-// carSimulatorRace
-// id = car number
-// delay = time lost due to start of the race (1st car has no delay, 2nd .5s delay, ...)
-// maxLap = how many lap to to end the race
-void carSimulatorRace(int id, CarTime delay, int maxLap) {
-	// initialize randomizer with time+id, so that all car are different :-)
-	srand(time(NULL)+(id*100));
-
-	// determine very 1st section time
-	CarTime sectionTime;
-	sectionTime.seconds = 25 + (rand() % 10); // between 25 and 35 seconds (we will add delay)
-	sectionTime.milliseconds = rand() % 1000;
-
-	// add delay (time lost on starting grid), between 0 and 9,5 seconds
-	combineCarTime(&sectionTime,delay);
-
-	// determine pit stop strategy
-	int pitStopLap[3];
-	if (maxLap < 35 || (rand() % 2) == 0) {
-		// 2 stops
-		pitStopLap[0]=maxLap/3+(rand()%11)-5;
-		pitStopLap[1]=(maxLap/3)*2+(rand()%11)-5;
-		pitStopLap[2]=9999; // no 3rd pit stop
-	} else {
-		// 3 stops
-		pitStopLap[0]=maxLap/4+(rand()%11)-5;
-		pitStopLap[1]=maxLap/2+(rand()%11)-5;
-		pitStopLap[2]=(maxLap/4)*3+(rand()%11)-5;
+// carSimulatorRaceNext: 1 event per section, for the number of lap * 3 (number of section)
+bool carSimulatorRaceNext(CarSimulatorState* state, bool raceOver, CarTimeAndStatus* carTimeStatus, int* waitMillis) {
+	if (state->section >= state->maxLap*3 || !state->running) {
+		state->step = CAR_SIMULATOR_DONE;
+		return false;
 	}
 
-	// loop for the number of lap * 3 (number of section)
-	bool running = true;
+	int i = state->section;
 	bool crashed = false;
 	bool pitStop = false;
-	for (int i = 0; i < maxLap*3 && running; i++) {
-		// check if pit stop
-		if ((i % 3 == 2) && ((i/3)==pitStopLap[0] || (i/3)==pitStopLap[1] || (i/3)==pitStopLap[2])) {
-			CarTime pitStopTime;
-			pitStopTime.seconds = 15 + (rand() % 5);
-			pitStopTime.milliseconds = rand() % 1000;
-			combineCarTime(&sectionTime,pitStopTime);
-			pitStop = true;
-		} else {
-			pitStop = false;
-		}
 
-		// check if end of race (someone already reached finish line)
-		if (i % 3 == 2) {
-			if (isRaceOver()) {
-				running = false;
-			}
-		}
+	// check if pit stop
+	if ((i % 3 == 2) && ((i/3)==state->pitStopLap[0] || (i/3)==state->pitStopLap[1] || (i/3)==state->pitStopLap[2])) {
+		state->sectionTime += (15 + rngInt(&state->rng, 5)) * CAR_TIME_SECOND;
+		state->sectionTime += rngInt(&state->rng, 1000) * CAR_TIME_MILLISECOND;
+		pitStop = true;
+	}
 
-		// check if car has not crashed
-		if ((rand() % 3000) == 0) {
-			crashed=true;
-			running=false;
+	// check if end of race (someone already reached finish line)
+	if (i % 3 == 2) {
+		if (raceOver) {
+			state->running = false;
 		}
+	}
 
-		// in case we are not able to immediatly update data, we will wait a few milliseconds, keep track of those waits
-		CarTimeAndStatus carTimeStatus;
-		long alreadyWait;
+	// check if car has not crashed
+	if (rngInt(&state->rng, 3000) == 0) {
+		crashed=true;
+		state->running=false;
+	}
 
-		if (crashed) {
-			carTimeStatus.carStatus = CRASHED;
-		} else {
-			carTimeStatus.sectionTime.seconds = sectionTime.seconds;
-			carTimeStatus.sectionTime.milliseconds = sectionTime.milliseconds;
-			carTimeStatus.carStatus = pitStop ? PITSTOP : RUNNING;
+	carTimeStatus->sectionTime = state->sectionTime;
+	*waitMillis = 0;
+	if (crashed) {
+		carTimeStatus->carStatus = CRASHED;
+	} else {
+		carTimeStatus->carStatus = pitStop ? PITSTOP : RUNNING;
+
+		// time on track
+		*waitMillis = state->sectionTime / CAR_TIME_MILLISECOND;
+
+		// determine next section time, between 3 seconds more or less than current section time
+		// note: may not be less than 25 or more then 45
+		// add between -2.999 and 2.999
+		state->sectionTime += (rngInt(&state->rng, 5) - 2) * CAR_TIME_SECOND;
+		state->sectionTime += (rngInt(&state->rng, 1998) - 999) * CAR_TIME_MILLISECOND;
+
+		// Fix if more than 45 or less than 25 (between 25.000 and 44.999), the fraction of second is kept
+		if (state->sectionTime >= 45 * CAR_TIME_SECOND) {
+			state->sectionTime = 44 * CAR_TIME_SECOND + state->sectionTime % CAR_TIME_SECOND;
+		} else if (state->sectionTime < 25 * CAR_TIME_SECOND) {
+			state->sectionTime = 25 * CAR_TIME_SECOND + state->sectionTime % CAR_TIME_SECOND;
 		}
-		alreadyWait = sendDataToController(id,carTimeStatus);
+	}
+
+	state->section++;
+	return true;
+}
+
+// carSimulatorQualificationNext: loop as long as time is not reached
+// 1. car waits in stand, 2. car does a lap (3 sections), then back to 1.
+bool carSimulatorQualificationNext(CarSimulatorState* state, CarTimeAndStatus* carTimeStatus, int* waitMillis) {
+	*waitMillis = 0;
+
+	switch (state->step) {
+		case QUALIFICATION_IN_STAND:
+			if (state->sessionTime >= state->maxTime) {
+				// Qualification is over -> return to stand
+				state->step = QUALIFICATION_BACK_TO_STAND;
+				return carSimulatorQualificationNext(state, carTimeStatus, waitMillis);
+			}
 
-		if (!crashed) {
+			// 1. car waits in stand (1 to 7 minutes).  Min qualif time is 8 minutes !
+			int waitInStand = ((rngInt(&state->rng, 7) + 1) * 60) * 1000;
+			state->sessionTime += waitInStand;
+			carTimeStatus->sectionTime = state->sectionTime;
+			carTimeStatus->carStatus = WAIT_IN_STAND;
+			if (state->sessionTime > state->maxTime) {
+				// no time left to do a final lap, stop immediatly
+				state->step = QUALIFICATION_BACK_TO_STAND;
+			} else {
+				// simulate time in stand
+				*waitMillis = waitInStand;
+				state->step = QUALIFICATION_LAP;
+			}
+			return true;
+
+		case QUALIFICATION_LAP:
+			// 2. do a qualification lap
+			// 2a. check if car has not crashed
+			if (rngInt(&state->rng, 1000) == 0) {
+				carTimeStatus->sectionTime = state->sectionTime;
+				carTimeStatus->carStatus = CRASHED;
+				state->step = CAR_SIMULATOR_DONE; // car crashed, stop
+				return true;
+			}
+			state->section = 0;
+			state->step = QUALIFICATION_SECTION;
+			// no break: 1st section starts immediatly
+			// fall through
+
+		case QUALIFICATION_SECTION:
+			// 2b. do the lap
+			state->sectionTime += (rngInt(&state->rng, 5) - 2) * CAR_TIME_SECOND; // between -2 and 2
+			state->sectionTime += (rngInt(&state->rng, 1999) - 999) * CAR_TIME_MILLISECOND; // between -999 and 999
+
+			// not less than 25s and more than 45s, the fraction of second is kept
+			if (state->sectionTime < 25 * CAR_TIME_SECOND) {
+				state->sectionTime = 25 * CAR_TIME_SECOND + state->sectionTime % CAR_TIME_SECOND;
+			} else if (state->sectionTime >= 45 * CAR_TIME_SECOND) {
+				state->sectionTime = 44 * CAR_TIME_SECOND + state->sectionTime % CAR_TIME_SECOND;
+			}
+
+			// add time to session
+			state->sessionTime += state->sectionTime / CAR_TIME_MILLISECOND;
+			carTimeStatus->sectionTime = state->sectionTime;
+			carTimeStatus->carStatus = RUNNING;
 			// simulate time on track
-			millisWait(((1000L * sectionTime.seconds + sectionTime.milliseconds) / 60L) - alreadyWait);
-
-			// determine next section time, between 3 seconds more or less than current section time
-			// note: may not be less than 25 or more then 45
-			CarTime deltaCarTime;
-
-			// add between -2.999 and 2.999
-			deltaCarTime.seconds = (rand() % 5) - 2;
-			deltaCarTime.milliseconds = (rand() % 1998) - 999;
-			combineCarTime(&sectionTime,deltaCarTime);
-
-			// Fix if more than 45 or less than 25 (between 25.000 and 44.999)
-			if (sectionTime.seconds >= 45) {
-				sectionTime.seconds = 44;
-			} else if (sectionTime.seconds < 25) {
-				sectionTime.seconds=25;
+			*waitMillis = state->sectionTime / CAR_TIME_MILLISECOND;
+
+			state->section++;
+			if (state->section == 3) {
+				// lap done, back to the stand
+				state->step = QUALIFICATION_IN_STAND;
 			}
-		}
+			return true;
+
+		case QUALIFICATION_BACK_TO_STAND:
+			carTimeStatus->sectionTime = state->sectionTime;
+			carTimeStatus->carStatus = WAIT_IN_STAND;
+			state->step = CAR_SIMULATOR_DONE;
+			return true;
+
+		default:
+			return false;
 	}
 }
 
-// id = car number
-// maxTime = how many time, tha car may try to run
-void carSimulatorQualification(int id, int maxTime) {
-	// initialize randomizer with time+id, so that all car are different :-)
-	srand(time(NULL)+id);
+// ---------------------------------------------------------------
+/**
+ * Discrete event engine
+ * All the cars are state machines (see carSimulatorNext), the engine always runs the car with the earliest next event
+ * and adds the event to the car data (see foldCarEvent), so 1 thread can simulate thousands of cars.
+ * The engine uses a virtual clock: there is no wait, the session is simulated as fast as possible.
+*/
 
-	// determine base section time
-	CarTimeAndStatus carTimeStatus;
-	carTimeStatus.sectionTime.seconds = 25 + (rand() % 20); // between 25 and 44 seconds
-	carTimeStatus.sectionTime.milliseconds = rand() % 1000;
-
-	// loop as long as time is not reached
-	int sessionTime=0;
-	while (sessionTime < maxTime) {
-		// in case we are not able to immediatly update data, we will wait a few milliseconds, keep track of those waits
-		long alreadyWait;
-
-		// 1. car waits in stand (1 to 7 minutes).  Min qualif time is 8 minutes !
-		int waitInStand = (((rand() % 7) + 1) * 60) * 1000;
-		sessionTime += waitInStand;
-		carTimeStatus.carStatus = WAIT_IN_STAND;
-		alreadyWait = sendDataToController(id,carTimeStatus);
-		if (sessionTime > maxTime) {
-			// no time left to do a final lap, stop carSimulator immediatly
+// add a car in the priority queue (schedule->items must be big enough)
+void scheduleCar(CarSchedule* schedule, long long time, int car) {
+	// add at the end, then move up while the parent is later
+	int i = schedule->count++;
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		ScheduledCar* p = &schedule->items[parent];
+		if (p->time < time || (p->time == time && p->car < car)) {
 			break;
 		}
-		// simulate time in stand
-		millisWait((waitInStand / 60L) - alreadyWait);
+		schedule->items[i] = *p;
+		i = parent;
+	}
+	schedule->items[i].time = time;
+	schedule->items[i].car = car;
+}
 
-		// 2. do a qualification lap
-		// 2a. check if car has not crashed
-		if (rand() % 1000 == 0) {
-			carTimeStatus.carStatus = CRASHED;
-			sendDataToController(id,carTimeStatus);
-			break; // car crashed, stop carSimulator
-		}
+// remove the car with the earliest event from the priority queue, return false if empty
+bool nextScheduledCar(CarSchedule* schedule, ScheduledCar* next) {
+	if (schedule->count == 0) {
+		return false;
+	}
+	*next = schedule->items[0];
 
-		// 2b. do the lap
-		for (int section=0;section<3;section++) {
-			CarTime updateTime;
-			updateTime.seconds=(rand() % 5) - 2; // between -2 and 2
-			updateTime.milliseconds=(rand() % 1999) - 999; // between -999 and 999
-			combineCarTime(&(carTimeStatus.sectionTime), updateTime);
-
-			// not less than 25s and more than 45s
-			if (carTimeStatus.sectionTime.seconds<25) {
-				carTimeStatus.sectionTime.seconds=25;
-			} else if (carTimeStatus.sectionTime.seconds>44) {
-				carTimeStatus.sectionTime.seconds=44;
+	// move the last item down from the top
+	ScheduledCar last = schedule->items[--schedule->count];
+	int i = 0;
+	while (1) {
+		int child = 2 * i + 1;
+		if (child >= schedule->count) {
+			break;
+		}
+		ScheduledCar* c = &schedule->items[child];
+		if (child + 1 < schedule->count) {
+			ScheduledCar* right = &schedule->items[child + 1];
+			if (right->time < c->time || (right->time == c->time && right->car < c->car)) {
+				child++;
+				c = right;
 			}
-
-			// add time to session
-			sessionTime += carTimeStatus.sectionTime.seconds * 1000 + carTimeStatus.sectionTime.milliseconds;
-			carTimeStatus.carStatus = RUNNING;
-			alreadyWait = sendDataToController(id,carTimeStatus);
-			// simulate time on track
-			millisWait(((1000L * carTimeStatus.sectionTime.seconds + carTimeStatus.sectionTime.milliseconds) / 60L) - alreadyWait);
 		}
+		if (last.time < c->time || (last.time == c->time && last.car < c->car)) {
+			break;
+		}
+		schedule->items[i] = *c;
+		i = child;
 	}
-
-	// Qualification is over -> return to stand
-	if (carTimeStatus.carStatus != CRASHED) {
-		carTimeStatus.carStatus = WAIT_IN_STAND;
-		sendDataToController(id,carTimeStatus);
-	}
+	schedule->items[i] = last;
+	return true;
 }
 
-// -------------------------------------------------------------
-// Shared memory Clean-up function
-void cleanupSharedMemory(int signum) {
-	if (sharedMemory) {
-		// destroy semaphores
-		sem_destroy(&sharedMemory->mutex);
-		sem_destroy(&sharedMemory->mutread);
-		// detach from shared memory
-		shmdt(sharedMemory);
-		// clean shared memory (IPC_RMID), will be effectivelly done when all processes are detached
-		shmctl(shmget(SHM_KEY, sizeof(SharedMemory), 0666), IPC_RMID, NULL);
+// simulate a whole session: cars[i] sends its events to carStats[i]
+// ranking = running order at the end of the session (carCount elements, nobody reads it during the session,
+// so it is sorted once at the end instead of being updated after each event like in the controller)
+// return the number of events, virtualTime = duration of the session (ms)
+// journal = journal of the session (NULL = events not saved)
+long long runDiscreteEventSession(CarSimulatorState* cars, CarStat* carStats, int* ranking, int carCount, enum RacePhase phase, int maxLap, long long* virtualTime, Journal* journal) {
+	CarSchedule schedule;
+	schedule.items = malloc(sizeof(ScheduledCar) * carCount);
+	schedule.count = 0;
+	if (!schedule.items) {
+		perror("Unable to allocate the schedule");
+		exit(1);
 	}
-	exit(0);
-}
 
-// send data to controller, return "lost time" for update (time waited for locking semaphore and controller)
-int sendDataToController(int id, CarTimeAndStatus status) {
-	// variables to keep track of the time "lost" for sending the data
-	struct timespec start, end;
-	long alreadyWait = 0;
-
-	// Get start time
-	clock_gettime(CLOCK_MONOTONIC, &start);
+	// all cars start at the same time
+	for (int i = 0; i < carCount; i++) {
+		scheduleCar(&schedule, 0, i);
+	}
 
-	// loop until data are copied to shared memory
-	while (1) {
-		// Get writer exclusive access
-		sem_wait(&sharedMemory->mutex);
+	bool raceOver = false;
+	long long eventCount = 0;
+	*virtualTime = 0;
+	ScheduledCar next;
+	while (nextScheduledCar(&schedule, &next)) {
+		CarTimeAndStatus carTimeStatus;
+		int waitMillis;
+		*virtualTime = next.time;
 
-		// check if data already treated by controller
-		if (sharedMemory->carTimeAndStatuses[id].processed == false) {
-			// not treated, release exclusive access and wait a few milliseconds before retry
-			sem_post(&sharedMemory->mutex);
-			millisWait(rand() % 20 + 1);
-			// retry
+		if (!carSimulatorNext(&cars[next.car], raceOver, &carTimeStatus, &waitMillis)) {
+			// the car finished practice, qualification, sprint or race
 			continue;
 		}
 
-		// exclusive writer access granted and data processed by controller -> copy new section time and pitStop
-		memcpy(&sharedMemory->carTimeAndStatuses[id], &status, sizeof(CarTimeAndStatus));
-		sharedMemory->carTimeAndStatuses[id].processed = false;
-
-		// release exclusive access
-		sem_post(&sharedMemory->mutex);
+		eventCount++;
+		carTimeStatus.sessionMillis = next.time;
+		journalEvent(journal, next.car, carStats[next.car].distance % 3, &carTimeStatus);
+		if (foldCarEvent(&carStats[next.car], &carTimeStatus, phase, maxLap)) {
+			// race is over, all other cars must stop
+			raceOver = true;
+		}
 
-		// quit update loop
-		break;
+		// the car will send its next event when this one is done
+		scheduleCar(&schedule, next.time + waitMillis, next.car);
 	}
 
-	// Get end time
-	clock_gettime(CLOCK_MONOTONIC, &end);
-
-	// Compute diff in milliseconds
-	alreadyWait = (end.tv_sec - start.tv_sec) * 1000; // seconds to ms
-	alreadyWait += (end.tv_nsec - start.tv_nsec) / 1000000; // nanosecondes to ms
-
-	return alreadyWait;
+	free(schedule.items);
+	rankCars(carStats, ranking, carCount, (phase == RACE) || (phase == SPRINT));
+	return eventCount;
 }
 
-// read processed flag
-bool isCarTimeAndStatusProcessed(int id) {
-	bool abProcessed[MAX_PILOT];
+// run a race with carCount cars in the discrete event engine (on the 1st track) and display the throughput
+void stressTest(int carCount) {
+	CarSimulatorState* cars = malloc(sizeof(CarSimulatorState) * carCount);
+	CarStat* carStats = calloc(carCount, sizeof(CarStat));
+	int* ranking = malloc(sizeof(int) * carCount);
+	if (!cars || !carStats || !ranking) {
+		perror("Unable to allocate the cars");
+		exit(1);
+	}
+
+	uint64_t seed = nextSessionSeed();
+	for (int i = 0; i < carCount; i++) {
+		// same delay on the starting grid as a normal race
+		CarTime delay = i * 500 * CAR_TIME_MILLISECOND;
+		initCarSimulator(&cars[i], i, delay, 0, RACE, seed);
+		carStats[i].pilotNumber = i+1;
+		initCarStatTimes(&carStats[i]);
+	}
+
+	long long start = getMonotonicNanos();
+	long long virtualTime;
+	long long eventCount = runDiscreteEventSession(cars, carStats, ranking, carCount, RACE, getTrackLap(0, RACE), &virtualTime, NULL);
+	long long duration = getMonotonicNanos() - start;
+
+	int crashed = 0;
+	for (int i = 0; i < carCount; i++) {
+		if (carStats[i].crashed) {
+			crashed++;
+		}
+	}
+
+	printf("Discrete event engine: %d cars, race of %d laps at '%s', seed %llu\n", carCount, getTrackLap(0, RACE), tracks[0].name, (unsigned long long)seed);
+	printf(" %lld events in %.3f ms (%.0f events/s), simulated race time %lld:%02lld:%02lld, %d cars crashed\n",
+		eventCount, duration / 1000000.0, eventCount / (duration / 1000000000.0),
+		virtualTime / 3600000, (virtualTime / 60000) % 60, (virtualTime / 1000) % 60, crashed);
+
+	free(cars);
+	free(carStats);
+	free(ranking);
+}
+
+// -------------------------------------------------------------
+// Event journal: every event folded in a session is appended to race_nn_pp.journal
+// the controller (or the discrete event engine) copies the event in a block of 4 KB, a background thread
+// writes the full blocks (pwrite at offsets multiple of 4 KB): the hot loop never waits for the disk,
+// if the writer thread is late and all the blocks are full, the event is dropped (and counted)
+
+// create the journal of a session (NULL with --no-journal), carStats = cars running (for their pilot number)
+// resume = checkpoint of the session to continue (NULL = new session)
+Journal* openJournal(int race, enum RacePhase phase, int maxLap, const CarStat* carStats, int carCount, uint64_t seed, const Checkpoint* resume) {
+	if (options.noJournal) {
+		return NULL;
+	}
+	Journal* journal = calloc(1, sizeof(Journal));
+	if (!journal) {
+		perror("Unable to allocate the journal");
+		exit(1);
+	}
+
+	char filename[30];
+	sprintf(filename,"race_%02d_%s.journal",race+1,racePhaseToShortString(phase));
+	// a resumed session continues the journal (truncated after the checkpoint)
+	journal->fd = open(filename, O_WRONLY | O_CREAT | (resume ? 0 : O_TRUNC), 0644);
+	if (journal->fd == -1) {
+		perror("Unable to create the journal");
+		exit(1);
+	}
+
+	// header and pilot numbers fill the first blocks, so every block of records is aligned in the file
+	JournalFileHeader* header = &journal->header;
+	memcpy(header->magic, JOURNAL_FILE_MAGIC, sizeof(header->magic));
+	header->version = JOURNAL_FILE_VERSION;
+	header->recordSize = sizeof(JournalRecord);
+	size_t headerSize = sizeof(JournalFileHeader) + carCount * sizeof(int32_t);
+	header->headerSize = (headerSize + JOURNAL_BLOCK_SIZE - 1) / JOURNAL_BLOCK_SIZE * JOURNAL_BLOCK_SIZE;
+	header->carCount = carCount;
+	header->race = race;
+	header->phase = phase;
+	header->maxLap = maxLap;
+	header->seed = seed;
+	char* headerBlock = calloc(1, header->headerSize);
+	if (!headerBlock) {
+		perror("Unable to allocate the journal");
+		exit(1);
+	}
+	memcpy(headerBlock, header, sizeof(JournalFileHeader));
+	int32_t* pilots = (int32_t*)(headerBlock + sizeof(JournalFileHeader));
+	for (int i = 0; i < carCount; i++) {
+		pilots[i] = carStats[i].pilotNumber;
+	}
+	if (pwrite(journal->fd, headerBlock, header->headerSize, 0) != (ssize_t)header->headerSize) {
+		perror("Unable to write the journal");
+		exit(1);
+	}
+	free(headerBlock);
+
+	journal->blocks = aligned_alloc(JOURNAL_BLOCK_SIZE, (size_t)JOURNAL_BUFFER_BLOCKS * JOURNAL_BLOCK_SIZE);
+	if (!journal->blocks) {
+		perror("Unable to allocate the journal");
+		exit(1);
+	}
+	atomic_init(&journal->filled, 0);
+	atomic_init(&journal->written, 0);
+	if (resume) {
+		// the full blocks are in the file, the block being filled is in the checkpoint
+		unsigned int blocks = resume->header->journalRecords / JOURNAL_BLOCK_RECORDS;
+		if (ftruncate(journal->fd, header->headerSize + (off_t)blocks * JOURNAL_BLOCK_SIZE) != 0) {
+			perror("Unable to truncate the journal");
+			exit(1);
+		}
+		header->recordCount = resume->header->journalRecords;
+		header->droppedCount = resume->header->journalDropped;
+		journal->used = resume->header->partialRecords;
+		memcpy(&journal->blocks[(blocks % JOURNAL_BUFFER_BLOCKS) * JOURNAL_BLOCK_RECORDS], resume->journal, journal->used * sizeof(JournalRecord));
+		atomic_init(&journal->filled, blocks);
+		atomic_init(&journal->written, blocks);
+	}
+	// copies of the car simulators for the checkpoints: at the start of the session (same delay on the starting grid as main),
+	// or at the checkpoint resumed
+	journal->shadows = malloc(carCount * sizeof(CheckpointCar));
+	if (!journal->shadows) {
+		perror("Unable to allocate the journal");
+		exit(1);
+	}
+	for (int i = 0; i < carCount; i++) {
+		if (resume) {
+			journal->shadows[i] = resume->cars[i];
+		} else {
+			memset(&journal->shadows[i], 0, sizeof(CheckpointCar));
+			initCarSimulator(&journal->shadows[i].state, i, i * 500 * CAR_TIME_MILLISECOND, race, phase, seed);
+		}
+	}
+	atomic_init(&journal->closing, false);
+	atomic_init(&journal->error, 0);
+	atomic_init(&journal->checkpointPending, false);
+	sem_init(&journal->blockReady, 0, 0);
+	if (pthread_create(&journal->writer, NULL, journalWriter, journal) != 0) {
+		perror("Unable to start the journal writer");
+		exit(1);
+	}
+	return journal;
+}
+
+// append an event (section = section run by the car, before the event is folded), nothing if journal is NULL
+void journalEvent(Journal* journal, int car, int section, const CarTimeAndStatus* carTimeAndStatus) {
+	if (!journal || atomic_load_explicit(&journal->error, memory_order_relaxed)) {
+		return;
+	}
+	unsigned int filled = atomic_load_explicit(&journal->filled, memory_order_relaxed);
+	if (journal->used == 0 && filled - atomic_load_explicit(&journal->written, memory_order_acquire) == JOURNAL_BUFFER_BLOCKS) {
+		// all the blocks are waiting for the writer thread: drop the event rather than wait
+		journal->header.droppedCount++;
+		return;
+	}
+	JournalRecord* record = &journal->blocks[(filled % JOURNAL_BUFFER_BLOCKS) * JOURNAL_BLOCK_RECORDS + journal->used];
+	record->sectionTime = carTimeAndStatus->sectionTime;
+	record->sessionMillis = carTimeAndStatus->sessionMillis;
+	record->car = car;
+	record->section = section;
+	record->carStatus = carTimeAndStatus->carStatus;
+	journal->header.recordCount++;
+
+	if (++journal->used == JOURNAL_BLOCK_RECORDS) {
+		// block full: give it to the writer thread
+		journal->used = 0;
+		atomic_store_explicit(&journal->filled, filled + 1, memory_order_release);
+		sem_post(&journal->blockReady);
+	}
+}
+
+// background thread: write the full blocks in the order they were filled, then the checkpoint waiting (if any)
+// after a failed write the thread stops (error is set, the controller stops journaling, closeJournal reports it)
+void* journalWriter(void* arg) {
+	Journal* journal = arg;
+	for (;;) {
+		sem_wait(&journal->blockReady);
+		// closing is read before the drain: the blocks filled before closeJournal are all written before the thread stops
+		bool closing = atomic_load_explicit(&journal->closing, memory_order_acquire);
+		unsigned int written = atomic_load_explicit(&journal->written, memory_order_relaxed);
+		while (written != atomic_load_explicit(&journal->filled, memory_order_acquire)) {
+			off_t offset = journal->header.headerSize + (off_t)written * JOURNAL_BLOCK_SIZE;
+			if (pwrite(journal->fd, &journal->blocks[(written % JOURNAL_BUFFER_BLOCKS) * JOURNAL_BLOCK_RECORDS], JOURNAL_BLOCK_SIZE, offset) != JOURNAL_BLOCK_SIZE) {
+				atomic_store_explicit(&journal->error, errno ? errno : EIO, memory_order_relaxed);
+				return NULL;
+			}
+			journal->writes++;
+			written++;
+			atomic_store_explicit(&journal->written, written, memory_order_release);
+		}
+		if (atomic_load_explicit(&journal->checkpointPending, memory_order_acquire)) {
+			// the blocks filled before the checkpoint are written: the checkpoint only keeps the block being filled
+			if (!writeCheckpoint(journal)) {
+				atomic_store_explicit(&journal->error, errno ? errno : EIO, memory_order_relaxed);
+				return NULL;
+			}
+			atomic_store_explicit(&journal->checkpointPending, false, memory_order_release);
+		}
+		if (closing) {
+			return NULL;
+		}
+	}
+}
+
+// stop the writer thread, write the last (partial) block and the final header
+void closeJournal(Journal* journal) {
+	atomic_store_explicit(&journal->closing, true, memory_order_release);
+	sem_post(&journal->blockReady);
+	pthread_join(journal->writer, NULL);
+
+	int error = atomic_load_explicit(&journal->error, memory_order_relaxed);
+	if (!error) {
+		// the writer thread is stopped: the controller writes the rest itself
+		unsigned int filled = atomic_load_explicit(&journal->filled, memory_order_relaxed);
+		off_t offset = journal->header.headerSize + (off_t)filled * JOURNAL_BLOCK_SIZE;
+		size_t size = journal->used * sizeof(JournalRecord);
+		if (pwrite(journal->fd, &journal->blocks[(filled % JOURNAL_BUFFER_BLOCKS) * JOURNAL_BLOCK_RECORDS], size, offset) != (ssize_t)size
+				|| pwrite(journal->fd, &journal->header, sizeof(JournalFileHeader), 0) != sizeof(JournalFileHeader)) {
+			error = errno ? errno : EIO;
+		}
+	}
+	if (error) {
+		// the journal stopped during the session: only the blocks written are kept (no final header, as an interrupted session)
+		fprintf(stderr, "Unable to write the journal: %s (journal stopped after %u blocks)\n", strerror(error),
+			atomic_load_explicit(&journal->written, memory_order_relaxed));
+		journal->header.recordCount = (uint64_t)atomic_load_explicit(&journal->written, memory_order_relaxed) * JOURNAL_BLOCK_RECORDS;
+	}
+	close(journal->fd);
+	sem_destroy(&journal->blockReady);
+	free(journal->blocks);
+	free(journal->checkpoint);
+	free(journal->shadows);
+}
+
+// map a journal in memory (read only), return NULL if the file doesn't exist, stop the program if it isn't a journal
+const JournalFileHeader* mapJournal(const char* filename, size_t* size) {
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		if (errno == ENOENT) {
+			return NULL;
+		}
+		perror("Unable to read the journal");
+		exit(1);
+	}
+	off_t fileSize = lseek(fd, 0, SEEK_END);
+	if (fileSize < (off_t)sizeof(JournalFileHeader)) {
+		fprintf(stderr, "%s: invalid journal\n", filename);
+		exit(1);
+	}
+	const JournalFileHeader* header = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		perror("Unable to map the journal");
+		exit(1);
+	}
+	if (memcmp(header->magic, JOURNAL_FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != JOURNAL_FILE_VERSION
+			|| header->recordSize != sizeof(JournalRecord) || header->headerSize > fileSize
+			|| sizeof(JournalFileHeader) + header->carCount * sizeof(int32_t) > header->headerSize
+			|| header->carCount == 0 || header->carCount > UINT16_MAX + 1) {
+		fprintf(stderr, "%s: invalid journal\n", filename);
+		exit(1);
+	}
+	// race and phase are used as indexes (tracks, names of the phases)
+	if (header->race < 0 || header->race >= MAX_TRACK || header->phase < FREE_PRACTICE_1 || header->phase > RACE) {
+		fprintf(stderr, "%s: invalid race or phase in the journal (race %d, phase %d)\n", filename, header->race, header->phase);
+		exit(1);
+	}
+	*size = fileSize;
+	return header;
+}
+
+// pilot number of each car of the journal (carCount numbers)
+const int32_t* getJournalPilots(const JournalFileHeader* header) {
+	return (const int32_t*)(header + 1);
+}
+
+// records of the journal, in the order they were folded
+const JournalRecord* getJournalRecords(const JournalFileHeader* header) {
+	return (const JournalRecord*)((const char*)header + header->headerSize);
+}
+
+// number of complete records (the count of the header is 0 if the session was interrupted)
+long long getJournalRecordCount(const JournalFileHeader* header, size_t size) {
+	long long count = (size - header->headerSize) / sizeof(JournalRecord);
+	if (header->recordCount != 0 && (long long)header->recordCount < count) {
+		count = header->recordCount;
+	}
+	return count;
+}
+
+// --journal FILE: fold the events of a journal again and display, for each car, its laps (best, average, worst), pit stops and crash
+void analyzeJournal(const char* filename) {
+	size_t size;
+	const JournalFileHeader* header = mapJournal(filename, &size);
+	if (!header) {
+		printf("%s: no such journal\n", filename);
+		exit(1);
+	}
+	const int32_t* pilots = getJournalPilots(header);
+	const JournalRecord* records = getJournalRecords(header);
+	long long recordCount = getJournalRecordCount(header, size);
+	int carCount = header->carCount;
+
+	// same folding as the controller, plus the sum of the lap times and the slowest lap
+	// (on the heap: carCount comes from the file, up to 65535 cars)
+	CarStat* carStats = calloc(carCount, sizeof(CarStat));
+	long long* events = calloc(carCount, sizeof(long long));
+	int* laps = calloc(carCount, sizeof(int));
+	CarTime* lapSum = calloc(carCount, sizeof(CarTime));
+	CarTime* worstLap = calloc(carCount, sizeof(CarTime));
+	int* crashLap = calloc(carCount, sizeof(int));
+	if (!carStats || !events || !laps || !lapSum || !worstLap || !crashLap) {
+		perror("Unable to allocate the analysis of the journal");
+		exit(1);
+	}
+	for (int i = 0; i < carCount; i++) {
+		carStats[i].pilotNumber = pilots[i];
+		initCarStatTimes(&carStats[i]);
+	}
+	int lastMillis = 0;
+	for (long long r = 0; r < recordCount; r++) {
+		const JournalRecord* record = &records[r];
+		if (record->car >= carCount) {
+			fprintf(stderr, "%s: invalid car in event %lld\n", filename, r);
+			exit(1);
+		}
+		CarStat* carStat = &carStats[record->car];
+		CarTimeAndStatus carTimeAndStatus = { .sectionTime = record->sectionTime, .carStatus = record->carStatus, .sessionMillis = record->sessionMillis };
+		int distance = carStat->distance;
+		foldCarEvent(carStat, &carTimeAndStatus, header->phase, header->maxLap);
+		events[record->car]++;
+		lastMillis = record->sessionMillis > lastMillis ? record->sessionMillis : lastMillis;
+		if (record->carStatus == CRASHED) {
+			crashLap[record->car] = distance / 3 + 1;
+		} else if (carStat->distance != distance && carStat->distance % 3 == 0) {
+			// a lap is done
+			CarTime lap = carStat->currentSectionTime[0] + carStat->currentSectionTime[1] + carStat->currentSectionTime[2];
+			laps[record->car]++;
+			lapSum[record->car] += lap;
+			worstLap[record->car] = lap > worstLap[record->car] ? lap : worstLap[record->car];
+		}
+	}
+
+	printf("%s: race #%d - %s, %d cars, seed %llu\n", filename, header->race+1, racePhaseToString(header->phase), carCount, (unsigned long long)header->seed);
+	printf(" %lld events, session clock %d:%02d:%02d, %llu events dropped%s\n", recordCount,
+		lastMillis / 3600000, (lastMillis / 60000) % 60, (lastMillis / 1000) % 60, (unsigned long long)header->droppedCount,
+		header->recordCount == 0 ? " (session interrupted)" : "");
+	printf(" Car        Events  Laps  Best lap   Avg lap  Worst lap  Pit  Crash\n");
+	for (int i = 0; i < carCount; i++) {
+		printf(" %3d-%-3s  %8lld  %4d  %8.3f  %8.3f   %8.3f  %3d  ", pilots[i], getDriverShortName(pilots[i]), events[i], laps[i],
+			carStats[i].bestLap == CAR_TIME_NONE ? 0.0 : carStats[i].bestLap / (double)CAR_TIME_SECOND,
+			laps[i] ? lapSum[i] / (double)laps[i] / CAR_TIME_SECOND : 0.0, worstLap[i] / (double)CAR_TIME_SECOND, carStats[i].pitStopCount);
+		if (crashLap[i]) {
+			printf("lap %d\n", crashLap[i]);
+		} else {
+			printf("-\n");
+		}
+	}
+	free(carStats);
+	free(events);
+	free(laps);
+	free(lapSum);
+	free(worstLap);
+	free(crashLap);
+	munmap((void*)header, size);
+}
+
+// -------------------------------------------------------------
+// Checkpoints: every --checkpoint seconds, the controller copies the state of the session (CarStats, running order,
+// events folded by each car, block of the journal being filled) and the journal writer thread saves it in
+// race_nn_pp.checkpoint (temporary file renamed: a crash during the write keeps the previous checkpoint)
+// the state of each car simulator is rebuilt from the seed by the writer thread: the simulators are never stopped
+
+// place the parts of a checkpoint (base NULL = only compute the size)
+size_t layoutCheckpoint(Checkpoint* checkpoint, char* base, int carCount, int pilotRunning) {
+	size_t offset = 0;
+	checkpoint->header = (CheckpointHeader*)placeColumn(base, &offset, sizeof(CheckpointHeader));
+	checkpoint->carStats = (CarStat*)placeColumn(base, &offset, sizeof(CarStat) * carCount);
+	checkpoint->ranking = (int*)placeColumn(base, &offset, sizeof(int) * carCount);
+	checkpoint->cars = (CheckpointCar*)placeColumn(base, &offset, sizeof(CheckpointCar) * pilotRunning);
+	checkpoint->journal = (JournalRecord*)placeColumn(base, &offset, sizeof(JournalRecord) * JOURNAL_BLOCK_RECORDS);
+	return offset;
+}
+
+// copy the state of the session for the writer thread (nothing if the previous checkpoint is not written yet)
+void takeCheckpoint(Journal* journal, const CarStat* carStats, const int* ranking, const long long* events, const bool* sawRaceOver, bool raceOver, int sessionMillis) {
+	if (atomic_load_explicit(&journal->checkpointPending, memory_order_acquire)) {
+		return;
+	}
+	int pilotRunning = journal->header.carCount;
+	Checkpoint checkpoint;
+	if (!journal->checkpoint) {
+		journal->checkpointSize = layoutCheckpoint(&checkpoint, NULL, pilotCount, pilotRunning);
+		journal->checkpoint = calloc(1, journal->checkpointSize);
+		if (!journal->checkpoint) {
+			perror("Unable to allocate the checkpoint");
+			exit(1);
+		}
+	}
+	layoutCheckpoint(&checkpoint, journal->checkpoint, pilotCount, pilotRunning);
+
+	CheckpointHeader* header = checkpoint.header;
+	memcpy(header->magic, CHECKPOINT_FILE_MAGIC, sizeof(header->magic));
+	header->version = CHECKPOINT_FILE_VERSION;
+	header->size = journal->checkpointSize;
+	header->carStatSize = sizeof(CarStat);
+	header->carStateSize = sizeof(CarSimulatorState);
+	header->carCount = pilotCount;
+	header->pilotRunning = pilotRunning;
+	header->race = journal->header.race;
+	header->phase = journal->header.phase;
+	header->seed = journal->header.seed;
+	header->raceOver = raceOver;
+	header->sessionMillis = sessionMillis;
+	header->journalRecords = journal->header.recordCount;
+	header->journalDropped = journal->header.droppedCount;
+	header->partialRecords = journal->used;
+	header->sequence++;
+	memcpy(checkpoint.carStats, carStats, sizeof(CarStat) * pilotCount);
+	memcpy(checkpoint.ranking, ranking, sizeof(int) * pilotCount);
+	for (int i = 0; i < pilotRunning; i++) {
+		checkpoint.cars[i].events = events[i];
+		checkpoint.cars[i].sawRaceOver = sawRaceOver[i];
+	}
+	// the block being filled is not given to the writer thread yet
+	unsigned int filled = atomic_load_explicit(&journal->filled, memory_order_relaxed);
+	memcpy(checkpoint.journal, &journal->blocks[(filled % JOURNAL_BUFFER_BLOCKS) * JOURNAL_BLOCK_RECORDS], journal->used * sizeof(JournalRecord));
+
+	atomic_store_explicit(&journal->checkpointPending, true, memory_order_release);
+	sem_post(&journal->blockReady);
+}
+
+// writer thread: rebuild the car simulators and save the checkpoint taken by the controller (false + errno if it failed)
+bool writeCheckpoint(Journal* journal) {
+	long long start = getMonotonicNanos();
+	Checkpoint checkpoint;
+	layoutCheckpoint(&checkpoint, journal->checkpoint, pilotCount, journal->header.carCount);
+	CheckpointHeader* header = checkpoint.header;
+	for (int i = 0; i < header->pilotRunning; i++) {
+		// only the events folded since the previous checkpoint are simulated again
+		rebuildCarSimulator(&journal->shadows[i], checkpoint.cars[i].events, checkpoint.cars[i].sawRaceOver);
+		checkpoint.cars[i] = journal->shadows[i];
+	}
+
+	char filename[35];
+	char tmpFilename[40];
+	sprintf(filename,"race_%02d_%s.checkpoint",header->race+1,racePhaseToShortString(header->phase));
+	sprintf(tmpFilename,"%s.tmp",filename);
+	int fd = open(tmpFilename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		return false;
+	}
+	if (write(fd, journal->checkpoint, journal->checkpointSize) != (ssize_t)journal->checkpointSize) {
+		int error = errno;
+		close(fd);
+		errno = error;
+		return false;
+	}
+	if (close(fd) != 0 || rename(tmpFilename, filename) != 0) {
+		return false;
+	}
+	journal->checkpoints++;
+	journal->checkpointNanos += getMonotonicNanos() - start;
+	return true;
+}
+
+// advance a copy of a car simulator (car) up to its event number events (the car simulator is deterministic: same seed, same events)
+// sawRaceOver = the last event was computed after the end of the race; the flag only matters for the last event
+// (a car seeing it at the end of a lap stops, so it sends no other event)
+void rebuildCarSimulator(CheckpointCar* car, long long events, bool sawRaceOver) {
+	for (; car->events < events; car->events++) {
+		CarTimeAndStatus carTimeStatus;
+		int waitMillis;
+		carSimulatorNext(&car->state, sawRaceOver && car->events == events - 1, &carTimeStatus, &waitMillis);
+		car->virtualMillis += waitMillis;
+	}
+	car->sawRaceOver = sawRaceOver;
+}
+
+// --resume: read race_nn_pp.checkpoint (allocated, kept until the end of the program), return false if there is none
+bool loadCheckpoint(int race, enum RacePhase phase, Checkpoint* checkpoint) {
+	char filename[35];
+	sprintf(filename,"race_%02d_%s.checkpoint",race+1,racePhaseToShortString(phase));
+	FILE* file = fopen(filename,"rb");
+	if (!file) {
+		return false;
+	}
+	CheckpointHeader header;
+	int pilotRunning = getMaxPilotRunning(phase);
+	size_t size = layoutCheckpoint(checkpoint, NULL, pilotCount, pilotRunning);
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CHECKPOINT_FILE_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != CHECKPOINT_FILE_VERSION || header.size != size
+			|| header.carStatSize != sizeof(CarStat) || header.carStateSize != sizeof(CarSimulatorState)
+			|| header.carCount != pilotCount || header.pilotRunning != pilotRunning || header.race != race || header.phase != (int)phase) {
+		fprintf(stderr, "%s: invalid checkpoint (or saved by another version of the program)\n", filename);
+		exit(1);
+	}
+	char* base = malloc(size);
+	rewind(file);
+	if (!base || fread(base, size, 1, file) != 1) {
+		perror("Unable to read the checkpoint");
+		exit(1);
+	}
+	fclose(file);
+	layoutCheckpoint(checkpoint, base, pilotCount, pilotRunning);
+	return true;
+}
+
+// the session is saved: its checkpoint is useless
+void removeCheckpoint(int race, enum RacePhase phase) {
+	char filename[35];
+	sprintf(filename,"race_%02d_%s.checkpoint",race+1,racePhaseToShortString(phase));
+	if (unlink(filename) != 0 && errno != ENOENT) {
+		perror("Unable to remove the checkpoint");
+	}
+}
+
+// -------------------------------------------------------------
+// Replay: the events of a journal are folded again with the functions of the controller (foldCarEvent, moveCarInRanking)
+// and displayed with the functions of the screen manager, at any speed: nothing is simulated, so no car simulator,
+// no shared memory and no wait between 2 events (a seek folds the records again from the start of the journal)
+
+// map a journal and prepare the cars of its session, return false if the file doesn't exist
+bool openReplay(Replay* replay, const char* filename) {
+	memset(replay, 0, sizeof(Replay));
+	replay->header = mapJournal(filename, &replay->size);
+	if (!replay->header) {
+		return false;
+	}
+	replay->records = getJournalRecords(replay->header);
+	replay->recordCount = getJournalRecordCount(replay->header, replay->size);
+	replay->carCount = replay->header->carCount;
+	replay->race = (replay->header->phase == RACE) || (replay->header->phase == SPRINT);
+	if (replay->carCount > pilotCount) {
+		fprintf(stderr, "%s: %d cars, %d pilots in drivers.csv\n", filename, replay->carCount, pilotCount);
+		exit(1);
+	}
+	for (long long r = 0; r < replay->recordCount; r++) {
+		if (replay->records[r].car >= replay->carCount) {
+			fprintf(stderr, "%s: invalid car in event %lld\n", filename, r);
+			exit(1);
+		}
+		replay->duration = replay->records[r].sessionMillis > replay->duration ? replay->records[r].sessionMillis : replay->duration;
+	}
+
+	replay->carStats = malloc(sizeof(CarStat) * pilotCount);
+	replay->ranking = malloc(sizeof(int) * pilotCount);
+	replay->position = malloc(sizeof(int) * pilotCount);
+	replay->keys = malloc(sizeof(uint64_t) * pilotCount);
+	if (!replay->carStats || !replay->ranking || !replay->position || !replay->keys) {
+		perror("Unable to allocate the replay");
+		exit(1);
+	}
+	resetReplay(replay);
+	return true;
+}
+
+// go back to the start of the session: no record folded, all the cars in stand in the order of the grid
+void resetReplay(Replay* replay) {
+	const int32_t* pilots = getJournalPilots(replay->header);
+	memset(replay->carStats, 0, sizeof(CarStat) * pilotCount);
+	int car = 0;
+	for (; car < replay->carCount; car++) {
+		replay->carStats[car].pilotNumber = pilots[car];
+	}
+	// the pilots eliminated before this session (Q2, Q3, ...) are not in the journal
+	for (int i = 0; i < pilotCount; i++) {
+		bool running = false;
+		for (int j = 0; j < replay->carCount && !running; j++) {
+			running = (pilots[j] == drivers[i].id);
+		}
+		if (!running && car < pilotCount) {
+			replay->carStats[car++].pilotNumber = drivers[i].id;
+		}
+	}
+	for (int i = 0; i < pilotCount; i++) {
+		replay->carStats[i].inStand = true;
+		initCarStatTimes(&replay->carStats[i]);
+		replay->keys[i] = getCarSortKey(&replay->carStats[i], replay->race);
+	}
+	initRanking(replay->ranking, replay->position, pilotCount);
+	replay->next = 0;
+	replay->clock = 0;
+}
+
+// fold the records sent before sessionMillis (session clock), in the order the controller folded them
+void replayUntil(Replay* replay, int sessionMillis) {
+	const JournalFileHeader* header = replay->header;
+	while (replay->next < replay->recordCount && replay->records[replay->next].sessionMillis <= sessionMillis) {
+		const JournalRecord* record = &replay->records[replay->next++];
+		CarTimeAndStatus carTimeAndStatus = { .sectionTime = record->sectionTime, .carStatus = record->carStatus, .sessionMillis = record->sessionMillis };
+		foldCarEvent(&replay->carStats[record->car], &carTimeAndStatus, header->phase, header->maxLap);
+		replay->keys[record->car] = getCarSortKey(&replay->carStats[record->car], replay->race);
+		moveCarInRanking(replay->ranking, replay->position, replay->keys, record->car, replay->carCount);
+	}
+	replay->clock = sessionMillis > replay->clock ? sessionMillis : replay->clock;
+}
+
+// move the replay to sessionMillis: forward, the next records are folded, backward, the session is folded again from the start
+void seekReplay(Replay* replay, int sessionMillis) {
+	if (sessionMillis < replay->clock) {
+		resetReplay(replay);
+	}
+	replayUntil(replay, sessionMillis);
+}
+
+void closeReplay(Replay* replay) {
+	munmap((void*)replay->header, replay->size);
+	free(replay->carStats);
+	free(replay->ranking);
+	free(replay->position);
+	free(replay->keys);
+}
+
+// wait at most timeoutMillis for a key of the replay, return 0 if no key was pressed
+// the arrows ← and → are returned as 'b' and 'f', CTRL+C as 'q'
+int readReplayKey(int timeoutMillis) {
+	struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+	if (poll(&input, 1, timeoutMillis) <= 0) {
+		return 0;
+	}
+	char keys[8];
+	ssize_t length = read(STDIN_FILENO, keys, sizeof(keys));
+	if (length <= 0) {
+		return 0;
+	}
+	if (length >= 3 && keys[0] == '\033' && keys[1] == '[') {
+		return keys[2] == 'D' ? 'b' : keys[2] == 'C' ? 'f' : 0;
+	}
+	return keys[0] == 3 ? 'q' : tolower(keys[0]);
+}
+
+// --replay FILE: display a recorded session like the screen manager, from --seek seconds, at --speed
+// keys: space = pause, + and - = speed x2 or /2 (up to the max speed: no wait), ← and → = 1 minute backward or forward, q = quit
+void runReplay(const char* filename) {
+	Replay replay;
+	if (!openReplay(&replay, filename)) {
+		printf("%s: no such journal\n", filename);
+		exit(1);
+	}
+	const JournalFileHeader* header = replay.header;
+	int position = options.replaySeekSeconds * 1000 < replay.duration ? options.replaySeekSeconds * 1000 : replay.duration;
+	seekReplay(&replay, position);
+
+	// the keys are read one by one, without echo (CTRL+C is read as a key to restore the terminal)
+	bool interactive = isatty(STDIN_FILENO);
+	struct termios savedTerminal;
+	if (interactive) {
+		tcgetattr(STDIN_FILENO, &savedTerminal);
+		struct termios terminal = savedTerminal;
+		terminal.c_lflag &= ~(ICANON | ECHO | ISIG);
+		terminal.c_cc[VMIN] = 1;
+		terminal.c_cc[VTIME] = 0;
+		tcsetattr(STDIN_FILENO, TCSANOW, &terminal);
+	}
+
+	printf("\033[2J"); // clear screen
+	printf("\033[1;1H Replay of %s", filename);
+	printf("\033[2;1H Race #%d - '%s' - '%s'", header->race+1, tracks[header->race].country, tracks[header->race].name);
+	printf("\033[3;1H Phase: '%s', %d cars, seed %llu", racePhaseToString(header->phase), replay.carCount, (unsigned long long)header->seed);
+	if (interactive) {
+		printf("\033[7;1H space: pause  + -: speed  ← →: 1 minute  q: quit");
+	}
+
+	int* previousPosition = malloc(pilotCount * sizeof(int));
+	if (!previousPosition) {
+		perror("Unable to allocate the replay");
+		exit(1);
+	}
+	for (int i = 0; i < pilotCount; i++) {
+		previousPosition[replay.ranking[i]] = i;
+	}
+	ScreenBuffer screen;
+	initScreenBuffer(&screen);
+	long long frameInterval = 1000000000LL / options.fps;
+	int speed = options.speed; // 0 = max speed
+	bool paused = false;
+	// session clock = anchorPosition + time since anchorTime x speed (anchor moved by each key)
+	int anchorPosition = position;
+	long long anchorTime = getMonotonicNanos();
+	long long lastPositions = anchorTime;
+	long long frames = 0;
+	bool quit = false;
+	while (!quit) {
+		long long now = getMonotonicNanos();
+		if (!paused) {
+			long long clock = speed ? anchorPosition + (now - anchorTime) * speed / 1000000 : replay.duration;
+			position = clock < replay.duration ? clock : replay.duration;
+		}
+		replayUntil(&replay, position);
+		bool ended = (replay.next == replay.recordCount);
+
+		if (now - lastPositions >= SCREEN_MAX_FRAME_INTERVAL) {
+			// positions of the last second, for the position changes (↑, ↓)
+			for (int i = 0; i < pilotCount; i++) {
+				previousPosition[replay.ranking[i]] = i;
+			}
+			lastPositions = now;
+		}
+
+		char speedText[8];
+		sprintf(speedText, speed ? "x%d" : "max", speed);
+		printf("\033[5;1H %s %d:%02d:%02d / %d:%02d:%02d  speed %-5s  ", ended ? "end  " : paused ? "pause" : "play ",
+			position / 3600000, (position / 60000) % 60, (position / 1000) % 60,
+			replay.duration / 3600000, (replay.duration / 60000) % 60, (replay.duration / 1000) % 60, speedText);
+		displayData(&screen, replay.carStats, replay.ranking, previousPosition, replay.race, replay.carCount);
+		frames++;
+
+		if (!interactive) {
+			// replay of a file without terminal (redirected input): until the end of the session
+			if (ended) {
+				break;
+			}
+			deadlineWait(now + frameInterval);
+			continue;
+		}
+
+		// the next frame is drawn after frameInterval, or as soon as a key is pressed
+		long long timeout = (now + frameInterval - getMonotonicNanos()) / 1000000;
+		int key = readReplayKey(timeout > 0 ? (int)timeout : 0);
+		switch (key) {
+			case 'q':
+				quit = true;
+				break;
+			case ' ':
+				paused = !paused;
+				break;
+			case '+':
+				speed = (speed == 0 || speed * 2 > 1000) ? 0 : speed * 2;
+				break;
+			case '-':
+				speed = speed == 0 ? 1000 : speed > 1 ? speed / 2 : 1;
+				break;
+			case 'b':
+			case 'f':
+				position += key == 'f' ? REPLAY_SEEK_MILLIS : -REPLAY_SEEK_MILLIS;
+				position = position < 0 ? 0 : position > replay.duration ? replay.duration : position;
+				seekReplay(&replay, position);
+				// no position change shown across a seek
+				for (int i = 0; i < pilotCount; i++) {
+					previousPosition[replay.ranking[i]] = i;
+				}
+				break;
+		}
+		if (key) {
+			anchorPosition = position;
+			anchorTime = getMonotonicNanos();
+		}
+	}
+
+	if (interactive) {
+		tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+	}
+	int bottom = getTerminalRows();
+	printf("\033[%d;1H\n %lld frames, %lld of %lld events replayed\n", bottom > 0 && bottom < pilotCount + 5 ? bottom : pilotCount + 5,
+		frames, replay.next, replay.recordCount);
+	freeScreenBuffer(&screen);
+	free(previousPosition);
+	closeReplay(&replay);
+}
+
+// --scan: replay every journal of the championship at max speed (without display) and compare the end of the session
+// with race_nn_pp.bin: same running order (or cars tied) and same best laps, else the session is reported as different
+// return the number of sessions different from their result
+int scanJournals() {
+	int sessions = 0;
+	int different = 0;
+	long long events = 0;
+	long long start = getMonotonicNanos();
+	for (int race=0;race<MAX_TRACK;race++) {
+		for (enum RacePhase phase=FREE_PRACTICE_1;phase<=RACE;phase++) {
+			char filename[35];
+			sprintf(filename,"race_%02d_%s.journal",race+1,racePhaseToShortString(phase));
+			Replay replay;
+			if (!openReplay(&replay, filename)) {
+				continue;
+			}
+			replayUntil(&replay, replay.duration);
+			sessions++;
+			events += replay.recordCount;
+
+			int crashes = 0;
+			int fastest = -1;
+			for (int i = 0; i < replay.carCount; i++) {
+				crashes += replay.carStats[i].crashed;
+				if (fastest == -1 || replay.carStats[i].bestLap < replay.carStats[fastest].bestLap) {
+					fastest = i;
+				}
+			}
+
+			// first position where the result is not the one of the replay
+			int differs = -1;
+			size_t size;
+			const ResultFileHeader* result = mapResultFile(race, phase, &size);
+			if (result) {
+				const ResultRecord* records = (const ResultRecord*)(result + 1);
+				for (int p = 0; p < replay.carCount && p < (int)result->recordCount && differs == -1; p++) {
+					int car = replay.ranking[p];
+					int saved = car;
+					for (int i = 0; i < replay.carCount; i++) {
+						if (replay.carStats[i].pilotNumber == records[p].pilotNumber) {
+							saved = i;
+						}
+					}
+					if (replay.keys[saved] != replay.keys[car] || replay.carStats[saved].bestLap != records[p].bestLap) {
+						differs = p;
+					}
+				}
+				munmap((void*)result, size);
+			}
+			different += (differs != -1);
+
+			int first = replay.carStats[replay.ranking[0]].pilotNumber;
+			printf("%-22s %2d cars %7lld events %3llu dropped  %d:%02d:%02d  1st %3d-%-3s  best lap %7.3f %3d-%-3s  %2d crashed  ",
+				filename, replay.carCount, replay.recordCount, (unsigned long long)replay.header->droppedCount,
+				replay.duration / 3600000, (replay.duration / 60000) % 60, (replay.duration / 1000) % 60,
+				first, getDriverShortName(first),
+				replay.carStats[fastest].bestLap / (double)CAR_TIME_SECOND, replay.carStats[fastest].pilotNumber,
+				getDriverShortName(replay.carStats[fastest].pilotNumber), crashes);
+			if (!result) {
+				printf("no result\n");
+			} else if (differs != -1) {
+				printf("DIFFERENT from position %d\n", differs+1);
+			} else {
+				printf("same result\n");
+			}
+			closeReplay(&replay);
+		}
+	}
+	long long duration = getMonotonicNanos() - start;
+	printf("%d journals, %lld events replayed in %.3f ms (%.1f M events/s), %d different from their result\n",
+		sessions, events, duration / 1000000.0, duration ? events * 1000.0 / duration : 0.0, different);
+	return different;
+}
+
+// -------------------------------------------------------------
+// Random numbers: xoshiro128** seeded with splitmix64
+// the generator of a car only depends on the seed of the session and the car number,
+// so a session can be replayed bit for bit (same seed) and the simulators share no state
+
+// splitmix64: return the next value of the sequence x (used to expand a seed)
+uint64_t splitMix64(uint64_t* x) {
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// initialize rng with the stream (car, season, ...) of seed
+void rngSeed(Rng* rng, uint64_t seed, uint64_t stream) {
+	uint64_t x = seed ^ splitMix64(&stream);
+	uint64_t a = splitMix64(&x);
+	uint64_t b = splitMix64(&x);
+	rng->s[0] = (uint32_t)a;
+	rng->s[1] = (uint32_t)(a >> 32);
+	rng->s[2] = (uint32_t)b;
+	rng->s[3] = (uint32_t)(b >> 32);
+	if ((a | b) == 0) {
+		// the state must not be all 0
+		rng->s[0] = 1;
+	}
+}
+
+// return the next 32 bits random number
+uint32_t rngNext(Rng* rng) {
+	uint32_t* s = rng->s;
+	uint32_t x = s[1] * 5;
+	uint32_t result = ((x << 7) | (x >> 25)) * 9;
+	uint32_t t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 11) | (s[3] >> 21);
+
+	return result;
+}
+
+// return a random number between 0 and n-1 (replaces rand() % n, without division)
+int rngInt(Rng* rng, int n) {
+	return (int)(((uint64_t)rngNext(rng) * (uint32_t)n) >> 32);
+}
+
+// return the seed of the next session: --seed (or the default seed) for the 1st one,
+// then a new seed derived from the previous one (--headless with several sessions)
+uint64_t nextSessionSeed() {
+	uint64_t seed = options.seed;
+	options.seed = splitMix64(&options.seed);
+	return seed;
+}
+
+// -------------------------------------------------------------
+// Section batch kernel: advance 1 race section for all the cars of a SectionBatch
+// (same rules as carSimulatorRaceNext: pit stop, crash, next section time between -2.999 and +2.999 s, clamped to 25..44 s)
+// each section consumes 5 random numbers for every car (even if there is no pit stop), so all the lanes stay in step
+// and the vector kernel gives exactly the same result as the scalar reference
+
+// create a batch of carCount cars (see startSectionBatch)
+SectionBatch* createSectionBatch(int carCount) {
+	SectionBatch* batch = calloc(1, sizeof(SectionBatch));
+	if (!batch) {
+		perror("Unable to allocate section batch");
+		exit(1);
+	}
+	batch->count = (carCount + SECTION_BATCH_LANES - 1) / SECTION_BATCH_LANES * SECTION_BATCH_LANES;
+
+	// arrays are aligned on cache lines, so a vector load never crosses a line
+	size_t size = (batch->count * sizeof(int32_t) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+	int32_t** arrays[] = { &batch->sectionMillis, &batch->totalMillis, &batch->section, &batch->pitStopLap[0],
+		&batch->pitStopLap[1], &batch->pitStopLap[2], &batch->running, &batch->crashed, &batch->paceMillis,
+		(int32_t**)&batch->rng[0], (int32_t**)&batch->rng[1], (int32_t**)&batch->rng[2], (int32_t**)&batch->rng[3] };
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+		*arrays[i] = aligned_alloc(CACHE_LINE_SIZE, size);
+		if (!*arrays[i]) {
+			perror("Unable to allocate section batch");
+			exit(1);
+		}
+		memset(*arrays[i], 0, size);
+	}
+	return batch;
+}
+
+// put the cars at the start of a race of maxLap laps (same grid delays as a normal race): the batch contains
+// carCount / gridSize grids, car i is the car i % gridSize of its grid, its random numbers are the stream firstStream + i
+// (gridStreams = the stream firstStream + i / gridSize: all the cars of a grid get the same random numbers, only the delay
+// on the starting grid and the pace change)
+// gridPaces = paceMillis of the cars of a grid (gridSize elements, NULL = all the cars have the same pace)
+void startSectionBatch(SectionBatch* batch, int carCount, int gridSize, const int32_t* gridPaces, int maxLap, uint64_t seed, uint64_t firstStream, bool gridStreams) {
+	for (int i = 0; i < batch->count; i++) {
+		Rng rng;
+		rngSeed(&rng, seed, gridStreams ? firstStream + i / gridSize : firstStream + i);
+		batch->totalMillis[i] = 0;
+		batch->section[i] = 0;
+		batch->crashed[i] = 0;
+		batch->running[i] = 0;
+		batch->sectionMillis[i] = 0;
+		batch->paceMillis[i] = 0;
+		batch->pitStopLap[0][i] = batch->pitStopLap[1][i] = batch->pitStopLap[2][i] = 9999;
+		if (i < carCount) {
+			// 1st section between 25 and 35 seconds + delay on the starting grid, 2 or 3 pit stops
+			batch->sectionMillis[i] = 25000 + rngInt(&rng, 10000) + (i % gridSize) * 500;
+			batch->running[i] = -1;
+			if (gridPaces) {
+				batch->paceMillis[i] = gridPaces[i % gridSize];
+			}
+			if (maxLap < 35 || rngInt(&rng, 2) == 0) {
+				batch->pitStopLap[0][i] = maxLap/3 + rngInt(&rng, 11) - 5;
+				batch->pitStopLap[1][i] = (maxLap/3)*2 + rngInt(&rng, 11) - 5;
+			} else {
+				batch->pitStopLap[0][i] = maxLap/4 + rngInt(&rng, 11) - 5;
+				batch->pitStopLap[1][i] = maxLap/2 + rngInt(&rng, 11) - 5;
+				batch->pitStopLap[2][i] = (maxLap/4)*3 + rngInt(&rng, 11) - 5;
+			}
+		}
+		for (int j = 0; j < 4; j++) {
+			batch->rng[j][i] = rng.s[j];
+		}
+	}
+}
+
+void freeSectionBatch(SectionBatch* batch) {
+	free(batch->sectionMillis);
+	free(batch->totalMillis);
+	free(batch->section);
+	for (int i = 0; i < 3; i++) {
+		free(batch->pitStopLap[i]);
+	}
+	free(batch->running);
+	free(batch->crashed);
+	free(batch->paceMillis);
+	for (int i = 0; i < 4; i++) {
+		free(batch->rng[i]);
+	}
+	free(batch);
+}
+
+// random number between 0 and n-1 (n < 65536) from a 32 bits random number: ((random >> 16) * n) >> 16
+// only 32 bits multiplications, so the vector kernel can do the same computation in each lane
+int batchRandom(uint32_t random, int n) {
+	return (int)(((random >> 16) * (uint32_t)n) >> 16);
+}
+
+// scalar reference: 1 car at a time (crashOdds: 1 chance out of crashOdds to crash in the section)
+void advanceSectionScalar(SectionBatch* batch, int maxLap, int crashOdds) {
+	for (int i = 0; i < batch->count; i++) {
+		Rng rng;
+		for (int j = 0; j < 4; j++) {
+			rng.s[j] = batch->rng[j][i];
+		}
+		uint32_t pitSeconds = rngNext(&rng);
+		uint32_t pitMillis = rngNext(&rng);
+		uint32_t crash = rngNext(&rng);
+		uint32_t deltaSeconds = rngNext(&rng);
+		uint32_t deltaMillis = rngNext(&rng);
+		for (int j = 0; j < 4; j++) {
+			batch->rng[j][i] = rng.s[j];
+		}
+
+		if (!batch->running[i]) {
+			continue;
+		}
+		int32_t t = batch->sectionMillis[i];
+		int lap = batch->section[i] / 3;
+		if (batch->section[i] % 3 == 2 && (lap == batch->pitStopLap[0][i] || lap == batch->pitStopLap[1][i] || lap == batch->pitStopLap[2][i])) {
+			t += (15 + batchRandom(pitSeconds, 5)) * 1000 + batchRandom(pitMillis, 1000);
+		}
+		if (batchRandom(crash, crashOdds) == 0) {
+			batch->running[i] = 0;
+			batch->crashed[i] = -1;
+			continue;
+		}
+		batch->totalMillis[i] += t + batch->paceMillis[i];
+		batch->section[i]++;
+		if (batch->section[i] >= maxLap * 3) {
+			batch->running[i] = 0;
+		}
+
+		// next section time, seconds between 25 and 44 (milliseconds are kept)
+		t += (batchRandom(deltaSeconds, 5) - 2) * 1000 + batchRandom(deltaMillis, 1998) - 999;
+		if (t >= 45000) {
+			t = 44000 + t % 1000;
+		} else if (t < 25000) {
+			t = 25000 + t % 1000;
+		}
+		batch->sectionMillis[i] = t;
+	}
+}
+
+// xoshiro128** step of SECTION_BATCH_LANES generators (same as rngNext), s = the 4 words of the state
+// vectors are passed by pointer (returning a vector by value depends on the instruction set)
+void vecRngNext(VecU32* s, VecU32* result) {
+	VecU32 x = s[1] * 5;
+	*result = ((x << 7) | (x >> 25)) * 9;
+	VecU32 t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 11) | (s[3] >> 21);
+}
+
+// vector kernel: SECTION_BATCH_LANES cars at a time, branches are replaced by masks (-1 = true, 0 = false)
+void advanceSectionBatch(SectionBatch* batch, int maxLap, int crashOdds) {
+	for (int i = 0; i < batch->count; i += SECTION_BATCH_LANES) {
+		VecU32 s[4];
+		VecU32 random[5];
+		for (int j = 0; j < 4; j++) {
+			s[j] = *(VecU32*)&batch->rng[j][i];
+		}
+		for (int j = 0; j < 5; j++) {
+			vecRngNext(s, &random[j]);
+		}
+		for (int j = 0; j < 4; j++) {
+			*(VecU32*)&batch->rng[j][i] = s[j];
+		}
+		VecI32 pitSeconds = (VecI32)(((random[0] >> 16) * 5) >> 16);
+		VecI32 pitMillis = (VecI32)(((random[1] >> 16) * 1000) >> 16);
+		VecI32 crash = (VecI32)(((random[2] >> 16) * (uint32_t)crashOdds) >> 16);
+		VecI32 deltaSeconds = (VecI32)(((random[3] >> 16) * 5) >> 16);
+		VecI32 deltaMillis = (VecI32)(((random[4] >> 16) * 1998) >> 16);
+
+		VecI32 running = *(VecI32*)&batch->running[i];
+		VecI32 t = *(VecI32*)&batch->sectionMillis[i];
+		VecI32 section = *(VecI32*)&batch->section[i];
+		// divisions by constants are done with multiplications (exact for these ranges), vector units have no integer division
+		VecI32 lap = (VecI32)(((VecU32)section * 43691) >> 17); // section / 3, section < 98000
+
+		// pit stop at the end of the lap
+		VecI32 pitStop = running & (section - lap * 3 == 2)
+			& ((lap == *(VecI32*)&batch->pitStopLap[0][i]) | (lap == *(VecI32*)&batch->pitStopLap[1][i]) | (lap == *(VecI32*)&batch->pitStopLap[2][i]));
+		t += pitStop & ((15 + pitSeconds) * 1000 + pitMillis);
+
+		// crash: the section is not done
+		VecI32 crashed = running & (crash == 0);
+		*(VecI32*)&batch->crashed[i] |= crashed;
+		VecI32 done = running & ~crashed;
+		*(VecI32*)&batch->totalMillis[i] += done & (t + *(VecI32*)&batch->paceMillis[i]);
+		section -= done; // -1 = true
+		*(VecI32*)&batch->section[i] = section;
+		*(VecI32*)&batch->running[i] = done & (section < maxLap * 3);
+
+		// next section time, seconds between 25 and 44 (milliseconds are kept)
+		VecI32 next = t + (deltaSeconds - 2) * 1000 + deltaMillis - 999;
+		// next % 1000: next / 1000 = high bits of next * 274877907 (2^38 / 1000 rounded up), exact for 0 <= next < 2^32
+		// (the 1st section includes the delay on the grid, next is never negative)
+		VecI32 seconds = (VecI32)__builtin_convertvector((__builtin_convertvector((VecU32)next, VecU64) * 274877907) >> 38, VecU32);
+		VecI32 millis = next - seconds * 1000;
+		VecI32 tooSlow = next >= 45000;
+		VecI32 tooFast = next < 25000;
+		next = (tooSlow & (44000 + millis)) | (tooFast & (25000 + millis)) | (~(tooSlow | tooFast) & next);
+		*(VecI32*)&batch->sectionMillis[i] = (done & next) | (~done & t);
+	}
+}
+
+// same total time, number of sections and crash for all the cars of 2 batches
+bool sameSectionBatch(const SectionBatch* a, const SectionBatch* b) {
+	for (int i = 0; i < a->count; i++) {
+		if (a->totalMillis[i] != b->totalMillis[i] || a->section[i] != b->section[i] || a->crashed[i] != b->crashed[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// run a race with carCount cars with the scalar and vector kernels, check that the results are the same
+// and display the throughput (sections per second), return false if the results are different
+bool benchmarkSectionKernel(int carCount) {
+	int maxLap = getTrackLap(0, RACE);
+	uint64_t seed = nextSessionSeed();
+	SectionBatch* batches[2] = { createSectionBatch(carCount), createSectionBatch(carCount) };
+	startSectionBatch(batches[0], carCount, carCount, NULL, maxLap, seed, 0, false);
+	startSectionBatch(batches[1], carCount, carCount, NULL, maxLap, seed, 0, false);
+	long long durations[2];
+	long long sections[2];
+
+	printf("Section kernel: %d cars, race of %d laps at '%s', %d lanes, seed %llu\n",
+		carCount, maxLap, tracks[0].name, SECTION_BATCH_LANES, (unsigned long long)seed);
+	for (int k = 0; k < 2; k++) {
+		long long start = getMonotonicNanos();
+		for (int step = 0; step < maxLap * 3; step++) {
+			if (k == 0) {
+				advanceSectionScalar(batches[k], maxLap, 3000);
+			} else {
+				advanceSectionBatch(batches[k], maxLap, 3000);
+			}
+		}
+		durations[k] = getMonotonicNanos() - start;
+		sections[k] = 0;
+		for (int i = 0; i < batches[k]->count; i++) {
+			sections[k] += batches[k]->section[i];
+		}
+		printf(" %-6s: %lld sections in %8.3f ms, %6.1f M sections/s\n", k == 0 ? "scalar" : "vector",
+			sections[k], durations[k] / 1000000.0, sections[k] / (durations[k] / 1000.0));
+	}
+
+	bool same = sameSectionBatch(batches[0], batches[1]);
+	printf(" vector/scalar: %.2fx, results %s\n", (double)durations[0] / durations[1], same ? "identical" : "DIFFERENT");
+
+	freeSectionBatch(batches[0]);
+	freeSectionBatch(batches[1]);
+	return same;
+}
+
+// -------------------------------------------------------------
+// Championship projection: simulate the rest of the championship seasonCount times (Monte Carlo)
+// and display the probability of each final position and of the title for each pilot.
+// The discrete event engine takes ~1 ms per race, far too slow for many seasons: each sprint/race is run once
+// by the section batch kernel (same rules as carSimulatorRaceNext, without the events) for PROJECTION_SAMPLES grids,
+// then each season draws the result of each car from the samples of its grid position, so a season costs
+// a few random numbers per car and per session. The cars that finished are classified by total time, then
+// the crashed cars by distance. Each pilot has a pace from the points scored per sprint/race so far
+// (see PROJECTION_PACE_MILLIS), added to each section, so the leaders of the championship are more likely to score.
+
+// claim up to PROJECTION_CHUNK seasons of range, return the number of seasons claimed (0 = range is empty)
+int claimSeasons(ProjectionRange* range, int* first) {
+	if (atomic_load_explicit(&range->next, memory_order_relaxed) >= range->end) {
+		return 0;
+	}
+	int start = atomic_fetch_add_explicit(&range->next, PROJECTION_CHUNK, memory_order_relaxed);
+	if (start >= range->end) {
+		return 0;
+	}
+	*first = start;
+	return start + PROJECTION_CHUNK > range->end ? range->end - start : PROJECTION_CHUNK;
+}
+
+// run PROJECTION_SAMPLES grids of the sprint/race with the section kernel (same pace for all the cars)
+// and keep the finishing key of each car in session->samples (lane = sample * pilotCount + grid position)
+// all the cars of a sample get the same random numbers: the grid positions only differ by their delay,
+// so the error of the samples is the same for all the cars and does not favour a grid position
+void sampleSession(SectionBatch* batch, ProjectedSession* session, uint64_t seed, uint64_t firstStream) {
+	int carCount = PROJECTION_SAMPLES * pilotCount;
+	startSectionBatch(batch, carCount, pilotCount, NULL, session->maxLap, seed, firstStream, true);
+	for (int step = 0; step < session->maxLap * 3; step++) {
+		advanceSectionBatch(batch, session->maxLap, 3000);
+	}
+	for (int i = 0; i < carCount; i++) {
+		if (batch->crashed[i]) {
+			session->samples[i] = ((uint64_t)1 << 32) | (uint32_t)(INT32_MAX - batch->section[i]);
+		} else {
+			session->samples[i] = (uint32_t)batch->totalMillis[i];
+		}
+	}
+}
+
+// simulate the sessions left for the seasons first to first+count-1 and count the final position of each pilot
+// the random numbers only depend on the seed and the season, not on the worker that simulates it
+void simulateSeasons(ProjectionWorker* worker, int first, int count) {
+	int* score = worker->score;
+	int* raceWon = worker->raceWon;
+	uint64_t* top = worker->top;
+	int scored = pilotCount < 10 ? pilotCount : 10;
+	for (int season = first; season < first + count; season++) {
+		Rng rng;
+		rngSeed(&rng, worker->seed, season);
+		for (int i = 0; i < pilotCount; i++) {
+			score[i] = worker->standings[i].score;
+			raceWon[i] = worker->standings[i].raceWon;
+		}
+
+		for (int s = 0; s < worker->sessionCount; s++) {
+			const ProjectedSession* session = &worker->sessions[s];
+			// result of each car drawn from the samples of its grid position, the pace is added to the
+			// maxLap*3 sections of the cars that finished (the crashed cars are classified by distance only)
+			// only the first 10 score points: they are kept sorted in top (insertion), ties go to the 1st of the grid
+			int topCount = 0;
+			uint32_t random = 0;
+			for (int i = 0; i < pilotCount; i++) {
+				if (i % (32 / PROJECTION_SAMPLE_BITS) == 0) {
+					random = rngNext(&rng);
+				}
+				uint64_t key = session->samples[(random & (PROJECTION_SAMPLES - 1)) * pilotCount + i];
+				random >>= PROJECTION_SAMPLE_BITS;
+				if (key < ((uint64_t)1 << 32)) {
+					long long total = (long long)key + (long long)worker->paces[i] * session->maxLap * 3;
+					key = total > 0 ? (uint64_t)total : 0;
+				}
+				// the keys are below 2^33: the car index in the low 31 bits keeps the cars with the same key in the order of the grid
+				key = (key << 31) | i;
+				if (topCount == scored && key > top[scored - 1]) {
+					continue;
+				}
+				int j = topCount < scored ? topCount++ : scored - 1;
+				for (; j > 0 && top[j - 1] > key; j--) {
+					top[j] = top[j - 1];
+				}
+				top[j] = key;
+			}
+			for (int position = 0; position < scored; position++) {
+				int car = top[position] & INT32_MAX;
+				score[car] += getScore(position, session->phase);
+				if (position == 0) {
+					raceWon[car]++;
+				}
+			}
+		}
+
+		// final position = number of pilots ranked before (same order as comparePilotStat,
+		// the current standings break the ties)
+		for (int i = 0; i < pilotCount; i++) {
+			int position = 0;
+			for (int j = 0; j < pilotCount; j++) {
+				if (score[j] > score[i] || (score[j] == score[i] && (raceWon[j] > raceWon[i] || (raceWon[j] == raceWon[i] && j < i)))) {
+					position++;
+				}
+			}
+			worker->positionCounts[i * pilotCount + position]++;
+		}
+	}
+}
+
+// projection thread: sample its part of the sessions, simulate the seasons of its range,
+// then steal seasons from the other workers
+void* projectionWorker(void* arg) {
+	ProjectionWorker* worker = (ProjectionWorker*)arg;
+	int first;
+	int count;
+
+	if (worker->id < worker->sessionCount) {
+		SectionBatch* batch = createSectionBatch(PROJECTION_SAMPLES * pilotCount);
+		for (int s = worker->id; s < worker->sessionCount; s += worker->workerCount) {
+			sampleSession(batch, &worker->sessions[s], worker->sampleSeed, (uint64_t)s * PROJECTION_SAMPLES);
+		}
+		freeSectionBatch(batch);
+	}
+	pthread_barrier_wait(worker->sampled);
+
+	worker->score = malloc(pilotCount * sizeof(int));
+	worker->raceWon = malloc(pilotCount * sizeof(int));
+	worker->top = malloc(10 * sizeof(uint64_t));
+	if (!worker->score || !worker->raceWon || !worker->top) {
+		perror("Unable to allocate the projection");
+		exit(1);
+	}
+
+	for (int victim = 0; victim < worker->workerCount; victim++) {
+		ProjectionRange* range = &worker->ranges[(worker->id + victim) % worker->workerCount];
+		while ((count = claimSeasons(range, &first)) > 0) {
+			simulateSeasons(worker, first, count);
+			worker->seasons += count;
+			if (victim > 0) {
+				worker->stolenSeasons += count;
+			}
+		}
+	}
+
+	free(worker->score);
+	free(worker->raceWon);
+	free(worker->top);
+	return NULL;
+}
+
+void projectChampionship(int seasonCount) {
+	int raceNumber;
+	enum RacePhase phase;
+	loadChampionshipState(&raceNumber, &phase);
+
+	// current standings, sorted
+	PilotStat* standings = malloc(pilotCount * sizeof(PilotStat));
+	int32_t* paces = malloc(pilotCount * sizeof(int32_t));
+	if (!standings || !paces) {
+		perror("Unable to allocate the projection");
+		exit(1);
+	}
+	int rounds = loadFinalChampionshipResult(raceNumber, standings, drivers);
+	qsort(standings, pilotCount, sizeof(PilotStat), comparePilotStat);
+
+	// pace of each pilot from the results so far: the pilots who scored more points per sprint/race than
+	// the average are faster in every section (all the cars have the same pace before the 1st sprint/race)
+	double averagePoints = 0;
+	for (int i = 0; i < pilotCount; i++) {
+		averagePoints += standings[i].score;
+	}
+	averagePoints /= pilotCount;
+	for (int i = 0; i < pilotCount; i++) {
+		paces[i] = rounds > 0 ? (int32_t)((averagePoints - standings[i].score) / rounds * PROJECTION_PACE_MILLIS) : 0;
+	}
+
+	// sprints and races still to run, using the same weekend sequence as main (sprint weekends from tracks.csv)
+	ProjectedSession sessions[MAX_TRACK * 2];
+	int sessionCount = 0;
+	while (getNextSession(&raceNumber, &phase)) {
+		if (phase == SPRINT || phase == RACE) {
+			sessions[sessionCount].phase = phase;
+			sessions[sessionCount].maxLap = getTrackLap(raceNumber, phase);
+			sessions[sessionCount].samples = malloc(sizeof(uint64_t) * PROJECTION_SAMPLES * pilotCount);
+			if (!sessions[sessionCount].samples) {
+				perror("Unable to allocate the projection");
+				exit(1);
+			}
+			sessionCount++;
+		}
+	}
+
+	long long start = getMonotonicNanos();
+
+	// 1 worker per core, each one starts with an equal part of the seasons
+	int workerCount = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workerCount < 1) {
+		workerCount = 1;
+	}
+	// the size given to aligned_alloc must be a multiple of the alignment (ProjectionRange is smaller than a cache line with COMPACT_SHM_LAYOUT)
+	size_t rangesSize = (sizeof(ProjectionRange) * workerCount + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+	ProjectionRange* ranges = aligned_alloc(CACHE_LINE_SIZE, rangesSize);
+	ProjectionWorker workers[workerCount];
+	pthread_t threads[workerCount];
+	long long* positionCounts = calloc((size_t)workerCount * pilotCount * pilotCount, sizeof(long long));
+	if (!ranges || !positionCounts) {
+		perror("Unable to allocate the projection");
+		exit(1);
+	}
+	uint64_t seed = nextSessionSeed();
+	// the samples and the seasons use other streams
+	uint64_t sampleSeed = seed;
+	sampleSeed = splitMix64(&sampleSeed);
+	pthread_barrier_t sampled;
+	pthread_barrier_init(&sampled, NULL, workerCount);
+	for (int i = 0; i < workerCount; i++) {
+		atomic_init(&ranges[i].next, (int)((long long)seasonCount * i / workerCount));
+		ranges[i].end = (int)((long long)seasonCount * (i+1) / workerCount);
+	}
+	for (int i = 0; i < workerCount; i++) {
+		workers[i].id = i;
+		workers[i].workerCount = workerCount;
+		workers[i].ranges = ranges;
+		workers[i].standings = standings;
+		workers[i].paces = paces;
+		workers[i].sessions = sessions;
+		workers[i].sessionCount = sessionCount;
+		workers[i].sampled = &sampled;
+		workers[i].sampleSeed = sampleSeed;
+		workers[i].seed = seed;
+		workers[i].positionCounts = &positionCounts[(size_t)i * pilotCount * pilotCount];
+		workers[i].seasons = 0;
+		workers[i].stolenSeasons = 0;
+		if (pthread_create(&threads[i], NULL, projectionWorker, &workers[i]) != 0) {
+			perror("Unable to create projection thread");
+			exit(1);
+		}
+	}
+
+	// merge the counts of all workers in the counts of the 1st one
+	long long stolenSeasons = 0;
+	for (int i = 0; i < workerCount; i++) {
+		pthread_join(threads[i], NULL);
+		stolenSeasons += workers[i].stolenSeasons;
+		if (i > 0) {
+			for (int j = 0; j < pilotCount * pilotCount; j++) {
+				positionCounts[j] += workers[i].positionCounts[j];
+			}
+		}
+	}
+	long long duration = getMonotonicNanos() - start;
+	pthread_barrier_destroy(&sampled);
+
+	printf("Championship projection: %d seasons, %d sprints/races left, %d threads (%lld seasons stolen), %.3f ms, seed %llu\n",
+		seasonCount, sessionCount, workerCount, stolenSeasons, duration / 1000000.0, (unsigned long long)seed);
+
+	// probability of the title and of each final position (only the first 20 positions)
+	int positionColumns = pilotCount < 20 ? pilotCount : 20;
+	printf("  # Pilot                           Pts  Title |");
+	for (int position = 0; position < positionColumns; position++) {
+		printf("  P%-3d", position+1);
+	}
+	printf("\n");
+	for (int i = 0; i < pilotCount; i++) {
+		printf("%3d %-30s %5d %5.1f%% |", i+1, standings[i].name, standings[i].score,
+			positionCounts[i * pilotCount] * 100.0 / seasonCount);
+		for (int position = 0; position < positionColumns; position++) {
+			printf(" %5.1f", positionCounts[i * pilotCount + position] * 100.0 / seasonCount);
+		}
+		printf("\n");
+	}
+
+	free(ranges);
+	free(positionCounts);
+	free(standings);
+	free(paces);
+	for (int s = 0; s < sessionCount; s++) {
+		free(sessions[s].samples);
+	}
+}
+
+// -------------------------------------------------------------
+// Self test (--self-test): check on random data (from the seed) the invariants the optimizations rely on
+// - rankCars (sort keys + radix sort) gives the same order as qsort with the comparators
+// - the vector section kernel gives the same result as the scalar reference
+// - a session resumed from its checkpoints (car simulators rebuilt by rebuildCarSimulator) sends exactly
+//   the same events as the session run without interruption
+
+// random grids of 1 to 5k cars and a grid at the start of a session (all the cars equal), return false if an order is different
+bool selfTestCarSort(Rng* rng) {
+	int sizes[4] = { 1, 20, 1000, 5000 };
+	bool allSame = true;
+	for (int s = 0; s < 4; s++) {
+		int carCount = sizes[s];
+		CarStat* carStats = calloc(carCount, sizeof(CarStat));
+		CarStat* sorted = malloc(sizeof(CarStat) * carCount);
+		int* ranking = malloc(sizeof(int) * carCount);
+		if (!carStats || !sorted || !ranking) {
+			perror("Unable to allocate the cars");
+			exit(1);
+		}
+		for (int grid = 0; grid < 2; grid++) {
+			if (grid == 0) {
+				fillRandomCarStats(carStats, carCount, rng);
+			} else {
+				memset(carStats, 0, sizeof(CarStat) * carCount);
+				for (int i = 0; i < carCount; i++) {
+					carStats[i].pilotNumber = i+1;
+					initCarStatTimes(&carStats[i]);
+				}
+			}
+			for (int race = 0; race < 2; race++) {
+				memcpy(sorted, carStats, sizeof(CarStat) * carCount);
+				qsort(sorted, carCount, sizeof(CarStat), race ? compareCarStatRace : compareCarStatQualification);
+				rankCars(carStats, ranking, carCount, race);
+				if (!sameCarOrder(sorted, carStats, ranking, carCount, race)) {
+					printf(" %s, %d cars: order DIFFERENT\n", race ? "race" : "qualification", carCount);
+					allSame = false;
+				}
+			}
+		}
+		free(carStats);
+		free(sorted);
+		free(ranking);
+	}
+	return allSame;
+}
+
+// 1 grid of 34001 cars (the delay on the starting grid goes beyond 2^24 ms, the limit of the exact integers in a float)
+// and 1000 grids of 20 cars with a random pace, the count is not a multiple of SECTION_BATCH_LANES
+// return false if the vector and scalar kernels give different results
+bool selfTestSectionKernel(Rng* rng, uint64_t seed) {
+	int maxLap = getTrackLap(0, RACE);
+	int carCounts[2] = { 34001, 20000 };
+	int gridSizes[2] = { 34001, 20 };
+	int32_t paces[20];
+	for (int i = 0; i < 20; i++) {
+		paces[i] = rngInt(rng, 8001) - 4000;
+	}
+
+	bool allSame = true;
+	for (int t = 0; t < 2; t++) {
+		SectionBatch* batches[2] = { createSectionBatch(carCounts[t]), createSectionBatch(carCounts[t]) };
+		for (int k = 0; k < 2; k++) {
+			startSectionBatch(batches[k], carCounts[t], gridSizes[t], t == 0 ? NULL : paces, maxLap, seed, 0, false);
+			for (int step = 0; step < maxLap * 3; step++) {
+				if (k == 0) {
+					advanceSectionScalar(batches[k], maxLap, 3000);
+				} else {
+					advanceSectionBatch(batches[k], maxLap, 3000);
+				}
+			}
+		}
+		if (!sameSectionBatch(batches[0], batches[1])) {
+			printf(" %d cars, grids of %d: results DIFFERENT\n", carCounts[t], gridSizes[t]);
+			allSame = false;
+		}
+		freeSectionBatch(batches[0]);
+		freeSectionBatch(batches[1]);
+	}
+	return allSame;
+}
+
+// run the cars of a session in the discrete event engine from their current state (like runDiscreteEventSession,
+// but car i sends its 1st event at startMillis[i]), *events = all the events in the order of the engine (allocated)
+// return the number of events
+long long runSelfTestSession(CarSimulatorState* cars, CarStat* carStats, int carCount, enum RacePhase phase, int maxLap, const long long* startMillis, bool raceOver, SelfTestEvent** events) {
+	CarSchedule schedule;
+	schedule.items = malloc(sizeof(ScheduledCar) * carCount);
+	schedule.count = 0;
+	if (!schedule.items) {
+		perror("Unable to allocate the schedule");
+		exit(1);
+	}
+	for (int i = 0; i < carCount; i++) {
+		scheduleCar(&schedule, startMillis[i], i);
+	}
+
+	long long eventCount = 0;
+	long long capacity = 0;
+	*events = NULL;
+	ScheduledCar next;
+	while (nextScheduledCar(&schedule, &next)) {
+		CarTimeAndStatus carTimeStatus;
+		int waitMillis;
+		if (!carSimulatorNext(&cars[next.car], raceOver, &carTimeStatus, &waitMillis)) {
+			continue;
+		}
+		carTimeStatus.sessionMillis = next.time;
+		if (eventCount == capacity) {
+			capacity = capacity ? capacity * 2 : 4096;
+			*events = realloc(*events, sizeof(SelfTestEvent) * capacity);
+			if (!*events) {
+				perror("Unable to allocate the events");
+				exit(1);
+			}
+		}
+		(*events)[eventCount].car = next.car;
+		(*events)[eventCount].event = carTimeStatus;
+		eventCount++;
+		if (foldCarEvent(&carStats[next.car], &carTimeStatus, phase, maxLap)) {
+			raceOver = true;
+		}
+		scheduleCar(&schedule, next.time + waitMillis, next.car);
+	}
+
+	free(schedule.items);
+	return eventCount;
+}
+
+// run a session (on the 1st track) without interruption, then resume it from checkpoints at 1/3 and 2/3 of the session,
+// just after the end of the race and at the last event: the checkpoint has the events folded before its time
+// and the car simulators are rebuilt incrementally from the previous checkpoint (like the shadows of the journal)
+// return false if a resumed session does not send the same events as the rest of the session
+bool selfTestResume(int carCount, enum RacePhase phase, uint64_t seed) {
+	int maxLap = getTrackLap(0, phase);
+	CarSimulatorState* cars = malloc(sizeof(CarSimulatorState) * carCount);
+	CarStat* carStats = malloc(sizeof(CarStat) * carCount);
+	CheckpointCar* shadows = calloc(carCount, sizeof(CheckpointCar));
+	long long* startMillis = calloc(carCount, sizeof(long long));
+	long long* events = malloc(sizeof(long long) * carCount);
+	bool* sawRaceOver = malloc(sizeof(bool) * carCount);
+	if (!cars || !carStats || !shadows || !startMillis || !events || !sawRaceOver) {
+		perror("Unable to allocate the cars");
+		exit(1);
+	}
+
+	for (int i = 0; i < carCount; i++) {
+		initCarSimulator(&cars[i], i, i * 500 * CAR_TIME_MILLISECOND, 0, phase, seed);
+		shadows[i].state = cars[i];
+		memset(&carStats[i], 0, sizeof(CarStat));
+		carStats[i].pilotNumber = i+1;
+		initCarStatTimes(&carStats[i]);
+	}
+	SelfTestEvent* reference;
+	long long referenceCount = runSelfTestSession(cars, carStats, carCount, phase, maxLap, startMillis, false, &reference);
+
+	// time of the checkpoints (increasing)
+	long long lastMillis = referenceCount > 0 ? reference[referenceCount - 1].event.sessionMillis : 0;
+	long long raceOverMillis = lastMillis;
+	for (long long e = 0; e < referenceCount; e++) {
+		if (reference[e].event.raceOver) {
+			raceOverMillis = reference[e].event.sessionMillis + 1;
+			break;
+		}
+	}
+	long long checkpointMillis[4] = { lastMillis / 3, lastMillis * 2 / 3, raceOverMillis, lastMillis };
+
+	bool same = true;
+	long long previousMillis = -1;
+	for (int c = 0; c < 4 && same; c++) {
+		if (checkpointMillis[c] <= previousMillis) {
+			continue;
+		}
+		previousMillis = checkpointMillis[c];
+
+		// state of the session at the checkpoint: the events before its time are folded
+		bool raceOver = false;
+		for (int i = 0; i < carCount; i++) {
+			memset(&carStats[i], 0, sizeof(CarStat));
+			carStats[i].pilotNumber = i+1;
+			initCarStatTimes(&carStats[i]);
+			events[i] = 0;
+			sawRaceOver[i] = false;
+		}
+		long long folded = 0;
+		for (; folded < referenceCount && reference[folded].event.sessionMillis < checkpointMillis[c]; folded++) {
+			int car = reference[folded].car;
+			events[car]++;
+			sawRaceOver[car] = reference[folded].event.raceOver;
+			if (foldCarEvent(&carStats[car], &reference[folded].event, phase, maxLap)) {
+				raceOver = true;
+			}
+		}
+		for (int i = 0; i < carCount; i++) {
+			rebuildCarSimulator(&shadows[i], events[i], sawRaceOver[i]);
+			cars[i] = shadows[i].state;
+			startMillis[i] = shadows[i].virtualMillis;
+		}
+
+		SelfTestEvent* resumed;
+		long long resumedCount = runSelfTestSession(cars, carStats, carCount, phase, maxLap, startMillis, raceOver, &resumed);
+		if (resumedCount != referenceCount - folded) {
+			same = false;
+		}
+		for (long long e = 0; e < resumedCount && same; e++) {
+			const SelfTestEvent* expected = &reference[folded + e];
+			if (resumed[e].car != expected->car || resumed[e].event.sectionTime != expected->event.sectionTime
+				|| resumed[e].event.carStatus != expected->event.carStatus || resumed[e].event.sessionMillis != expected->event.sessionMillis
+				|| resumed[e].event.raceOver != expected->event.raceOver) {
+				same = false;
+			}
+		}
+		if (!same) {
+			printf(" %s, checkpoint at %lld ms: %lld events resumed instead of %lld, or events DIFFERENT\n",
+				racePhaseToString(phase), checkpointMillis[c], resumedCount, referenceCount - folded);
+		}
+		free(resumed);
+	}
+
+	free(reference);
+	free(cars);
+	free(carStats);
+	free(shadows);
+	free(startMillis);
+	free(events);
+	free(sawRaceOver);
+	return same;
+}
+
+// --self-test: run all the checks, return false if one of them failed
+bool selfTest() {
+	uint64_t seed = nextSessionSeed();
+	Rng rng;
+	rngSeed(&rng, seed, 0);
+	printf("Self test, seed %llu\n", (unsigned long long)seed);
+
+	bool sortOk = selfTestCarSort(&rng);
+	printf(" sort keys + radix sort vs qsort: %s\n", sortOk ? "ok" : "FAILED");
+	bool sectionOk = selfTestSectionKernel(&rng, seed);
+	printf(" vector vs scalar section kernel: %s\n", sectionOk ? "ok" : "FAILED");
+	enum RacePhase phases[4] = { FREE_PRACTICE_1, QUALIFICATION_1, SPRINT, RACE };
+	bool resumeOk = true;
+	for (int p = 0; p < 4; p++) {
+		resumeOk &= selfTestResume(20, phases[p], seed + p);
+	}
+	printf(" resumed vs uninterrupted sessions: %s\n", resumeOk ? "ok" : "FAILED");
+	return sortOk && sectionOk && resumeOk;
+}
+
+// -------------------------------------------------------------
+// Create the shared memory of this run
+// the name is uniq (pid + start time) so several championships can run on the same host
+// childs created with fork() inherit the mapping (and the name in sharedMemoryName)
+// in thread mode (--threads), the same struct is simply allocated in the memory of the process
+void createSharedMemory() {
+	// SharedMemory, then pilotCount rings, then the columns of the CarStats, then the ranking (pilotCount int)
+	// sizeof(SharedMemory) and sizeof(CarEventRing) are multiples of the cache line (see CACHE_ALIGNED)
+	size_t carEventRingsOffset = sizeof(SharedMemory);
+	size_t carStatsOffset = carEventRingsOffset + sizeof(CarEventRing) * pilotCount;
+	size_t rankingOffset = carStatsOffset + layoutCarStatColumns(NULL, NULL, pilotCount);
+	sharedMemorySize = rankingOffset + sizeof(int) * pilotCount;
+	sharedMemoryOwner = getpid();
+
+	if (options.threads || options.headless) {
+		sharedMemory = (SharedMemory *)mmap(NULL, sharedMemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (sharedMemory == MAP_FAILED) {
+			perror("Error when allocating memory");
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		createNamedSharedMemory();
+	}
+	sharedMemory->carEventRings = (CarEventRing *)((char *)sharedMemory + carEventRingsOffset);
+	layoutCarStatColumns(&sharedMemory->carStats, (char *)sharedMemory + carStatsOffset, pilotCount);
+	sharedMemory->ranking = (int *)((char *)sharedMemory + rankingOffset);
+
+	// create semaphore
+	//   &sharedMemory->mutex/mutread: will be used between different processus, so located in the shared memory
+	//   1: indicates that the semaphore will be used between processus and not between threads (0 in thread mode)
+	//   1: initial value
+	int semaphorePshared = sharedMemoryName[0] ? 1 : 0;
+	sem_init(&sharedMemory->mutex, semaphorePshared, 1);
+	sem_init(&sharedMemory->mutread, semaphorePshared, 1);
+	//   0: no event published yet, the controller will sleep until the 1st one
+	sem_init(&sharedMemory->dataReady, semaphorePshared, 0);
+	//   0: nothing published yet, the screen manager will sleep until the 1st commit
+	sem_init(&sharedMemory->screenWakeup, semaphorePshared, 0);
+}
+
+// create the POSIX shared memory, shared with the child processes
+void createNamedSharedMemory() {
+	sprintf(sharedMemoryName, "%s-%d-%lld", SHM_NAME_PREFIX, getpid(), getMonotonicNanos());
+
+	// O_EXCL: never reuse a segment left by another run
+	int fd = shm_open(sharedMemoryName, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd == -1) {
+		perror("Error when creating shared memory");
+		exit(EXIT_FAILURE);
+	}
+
+	if (ftruncate(fd, sharedMemorySize) == -1) {
+		perror("Error when sizing shared memory");
+		shm_unlink(sharedMemoryName);
+		exit(EXIT_FAILURE);
+	}
+
+	sharedMemory = (SharedMemory *)mmap(NULL, sharedMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// the mapping stays valid after close
+	close(fd);
+	if (sharedMemory == MAP_FAILED) {
+		perror("Error when attaching to shared memory");
+		shm_unlink(sharedMemoryName);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Shared memory Clean-up function
+void cleanupSharedMemory(int signum) {
+	releaseSharedMemory();
+	exit(0);
+}
+
+// destroy the semaphores and detach from the shared memory (the owner also removes its name)
+void releaseSharedMemory() {
+	if (sharedMemory) {
+		if (getpid() == sharedMemoryOwner) {
+			// destroy semaphores
+			sem_destroy(&sharedMemory->mutex);
+			sem_destroy(&sharedMemory->mutread);
+			sem_destroy(&sharedMemory->dataReady);
+			sem_destroy(&sharedMemory->screenWakeup);
+			// remove the name (already done after the launch of the childs, but not if we are stopped before)
+			if (sharedMemoryName[0]) {
+				shm_unlink(sharedMemoryName);
+			}
+		}
+		// detach from shared memory, memory is freed when all processes are detached
+		munmap(sharedMemory, sharedMemorySize);
+		sharedMemory = NULL;
+	}
+}
+
+// send data to controller, wait for a free slot in the ring if needed
+// the time lost is not returned: the car simulator sleeps until absolute deadlines (see carSimulator)
+void sendDataToController(int id, CarTimeAndStatus status) {
+	CarEventRing* ring = &sharedMemory->carEventRings[id];
+
+	// only the car simulator moves head, the controller moves tail
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	// no credit left: the controller is CAR_EVENT_RING_SIZE events late, wait until it frees a slot (backpressure)
+	if (head - tail == CAR_EVENT_RING_SIZE) {
+		ring->creditStalls++;
+		do {
+			millisWait(1);
+			tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		} while (head - tail == CAR_EVENT_RING_SIZE);
+	}
+
+	// copy the event in the free slot, then publish it by moving head
+	status.sentAt = getMonotonicNanos();
+	memcpy(&ring->events[head % CAR_EVENT_RING_SIZE], &status, sizeof(CarTimeAndStatus));
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	// wake up the controller
+	sem_post(&sharedMemory->dataReady);
+
+	// keep track of the queue depth
+	if (head + 1 - tail > ring->maxDepth) {
+		ring->maxDepth = head + 1 - tail;
+	}
+}
 
-	readSharedMemoryData(abProcessed, PROCESSED_FLAGS);
+// get the event sent by car id at position index in the ring (0 = oldest), return false if there is no such event
+// the slot stays used until the controller commits it (see commitControllerUpdates)
+bool receiveDataFromCar(int id, int index, CarTimeAndStatus* status) {
+	CarEventRing* ring = &sharedMemory->carEventRings[id];
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
 
-	return abProcessed[id];
+	if (head - tail <= (unsigned int)index) {
+		// nothing to read
+		return false;
+	}
+
+	// copy the event
+	memcpy(status, &ring->events[(tail + index) % CAR_EVENT_RING_SIZE], sizeof(CarTimeAndStatus));
+
+	return true;
+}
+
+// number of events waiting in the ring of car id
+int getCarEventQueueDepth(int id) {
+	CarEventRing* ring = &sharedMemory->carEventRings[id];
+
+	return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
 }
 
 // read sharedMemoryData
 void readSharedMemoryData(void* data, enum SharedMemoryDataType smdt) {
+	if (smdt == CAR_STATS) {
+		readCarStats(data, NULL);
+		return;
+	}
+
 	// get exclusive access to reader variable
 	sem_wait(&sharedMemory->mutread);
 	// increment reader count
@@ -1371,22 +4762,13 @@ void readSharedMemoryData(void* data, enum SharedMemoryDataType smdt) {
 	sem_post(&sharedMemory->mutread);
 
 	switch(smdt) {
-		case CAR_STATS:
-			memcpy(data, &sharedMemory->carStats, sizeof(CarStat)*MAX_PILOT);
+		case CAR_STATS: // read with the sequence lock (see above)
 			break;
 		case RUNNING_CARS:
 			*((int*)data) = sharedMemory->runningCars;
 			break;
-		case CAR_TIME_AND_STATUSES:
-			memcpy(data, &sharedMemory->carTimeAndStatuses, sizeof(CarTimeAndStatus)*MAX_PILOT);
-			break;
 		case RACE_OVER:
-			*((bool*)data) = sharedMemory->raceOver;
-			break;
-		case PROCESSED_FLAGS:
-			for (int i=0;i<MAX_PILOT;i++) {
-				((bool*)data)[i] = sharedMemory->carTimeAndStatuses[i].processed;
-			}
+			*((bool*)data) = atomic_load_explicit(&sharedMemory->raceOver, memory_order_acquire);
 			break;
 	}
 
@@ -1402,6 +4784,140 @@ void readSharedMemoryData(void* data, enum SharedMemoryDataType smdt) {
 	sem_post(&sharedMemory->mutread);
 }
 
+// copy the carStats and the running order (if ranking is not NULL) published by the controller
+// they are protected by a sequence lock: copy them without blocking the controller,
+// and retry if the controller updated them during the copy
+// return the carStatsGeneration of the data copied
+unsigned int readCarStats(CarStat* carStats, int* ranking) {
+	unsigned int sequenceBefore, sequenceAfter;
+	unsigned int generation;
+	do {
+		sequenceBefore = atomic_load_explicit(&sharedMemory->carStatsSequence, memory_order_acquire);
+		if (sequenceBefore & 1) {
+			// write in progress
+			continue;
+		}
+		for (int i = 0; i < pilotCount; i++) {
+			getCarStat(i, &carStats[i]);
+		}
+		if (ranking) {
+			memcpy(ranking, sharedMemory->ranking, sizeof(int)*pilotCount);
+		}
+		generation = atomic_load_explicit(&sharedMemory->carStatsGeneration, memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+		sequenceAfter = atomic_load_explicit(&sharedMemory->carStatsSequence, memory_order_relaxed);
+	} while ((sequenceBefore & 1) || sequenceBefore != sequenceAfter);
+	return generation;
+}
+
+// return the address of the next column (base + offset, NULL if base is NULL) and move offset after it
+// the columns start on a cache line, so a column is never written on the same line as another one
+char* placeColumn(char* base, size_t* offset, size_t size) {
+	char* column = base ? base + *offset : NULL;
+	*offset += (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+	return column;
+}
+
+// place the columns of count CarStats at base and return the size used (base = NULL: only compute the size)
+size_t layoutCarStatColumns(CarStatColumns* columns, char* base, int count) {
+	CarStatColumns unused;
+	if (!columns) {
+		columns = &unused;
+	}
+	size_t offset = 0;
+	columns->pilotNumber = (int*)placeColumn(base, &offset, sizeof(int) * count);
+	columns->totalTime = (CarTime*)placeColumn(base, &offset, sizeof(CarTime) * count);
+	columns->distance = (int*)placeColumn(base, &offset, sizeof(int) * count);
+	for (int section = 0; section < 3; section++) {
+		columns->bestSectionTime[section] = (CarTime*)placeColumn(base, &offset, sizeof(CarTime) * count);
+		columns->currentSectionTime[section] = (CarTime*)placeColumn(base, &offset, sizeof(CarTime) * count);
+	}
+	columns->bestLap = (CarTime*)placeColumn(base, &offset, sizeof(CarTime) * count);
+	columns->pitStopCount = (int*)placeColumn(base, &offset, sizeof(int) * count);
+	columns->crashed = (bool*)placeColumn(base, &offset, sizeof(bool) * count);
+	columns->inStand = (bool*)placeColumn(base, &offset, sizeof(bool) * count);
+	return offset;
+}
+
+// copy the fields of car from the columns in shared memory
+// (no lock: used by the controller, under the sequence lock (readCarStats) or when no session is running)
+void getCarStat(int car, CarStat* carStat) {
+	CarStatColumns* columns = &sharedMemory->carStats;
+	carStat->pilotNumber = columns->pilotNumber[car];
+	carStat->totalTime = columns->totalTime[car];
+	carStat->distance = columns->distance[car];
+	for (int section = 0; section < 3; section++) {
+		carStat->bestSectionTime[section] = columns->bestSectionTime[section][car];
+		carStat->currentSectionTime[section] = columns->currentSectionTime[section][car];
+	}
+	carStat->bestLap = columns->bestLap[car];
+	carStat->pitStopCount = columns->pitStopCount[car];
+	carStat->crashed = columns->crashed[car];
+	carStat->inStand = columns->inStand[car];
+}
+
+// write the fields of car listed in columns (COLUMN_xxx bits) in shared memory, return the number of bytes written
+int putCarStat(int car, const CarStat* carStat, unsigned int columns) {
+	CarStatColumns* store = &sharedMemory->carStats;
+	int bytes = 0;
+	if (columns & COLUMN_PILOT_NUMBER) {
+		store->pilotNumber[car] = carStat->pilotNumber;
+		bytes += sizeof(int);
+	}
+	if (columns & COLUMN_TOTAL_TIME) {
+		store->totalTime[car] = carStat->totalTime;
+		bytes += sizeof(CarTime);
+	}
+	if (columns & COLUMN_DISTANCE) {
+		store->distance[car] = carStat->distance;
+		bytes += sizeof(int);
+	}
+	for (int section = 0; section < 3; section++) {
+		if (columns & (COLUMN_BEST_SECTION_TIME << section)) {
+			store->bestSectionTime[section][car] = carStat->bestSectionTime[section];
+			bytes += sizeof(CarTime);
+		}
+		if (columns & (COLUMN_CURRENT_SECTION_TIME << section)) {
+			store->currentSectionTime[section][car] = carStat->currentSectionTime[section];
+			bytes += sizeof(CarTime);
+		}
+	}
+	if (columns & COLUMN_BEST_LAP) {
+		store->bestLap[car] = carStat->bestLap;
+		bytes += sizeof(CarTime);
+	}
+	if (columns & COLUMN_PIT_STOP_COUNT) {
+		store->pitStopCount[car] = carStat->pitStopCount;
+		bytes += sizeof(int);
+	}
+	if (columns & COLUMN_CRASHED) {
+		store->crashed[car] = carStat->crashed;
+		bytes += sizeof(bool);
+	}
+	if (columns & COLUMN_IN_STAND) {
+		store->inStand[car] = carStat->inStand;
+		bytes += sizeof(bool);
+	}
+	return bytes;
+}
+
+// columns (COLUMN_xxx bits) of the fields that are different in before and after
+unsigned int getChangedColumns(const CarStat* before, const CarStat* after) {
+	unsigned int columns = 0;
+	columns |= before->pilotNumber != after->pilotNumber ? COLUMN_PILOT_NUMBER : 0;
+	columns |= before->totalTime != after->totalTime ? COLUMN_TOTAL_TIME : 0;
+	columns |= before->distance != after->distance ? COLUMN_DISTANCE : 0;
+	for (int section = 0; section < 3; section++) {
+		columns |= before->bestSectionTime[section] != after->bestSectionTime[section] ? COLUMN_BEST_SECTION_TIME << section : 0;
+		columns |= before->currentSectionTime[section] != after->currentSectionTime[section] ? COLUMN_CURRENT_SECTION_TIME << section : 0;
+	}
+	columns |= before->bestLap != after->bestLap ? COLUMN_BEST_LAP : 0;
+	columns |= before->pitStopCount != after->pitStopCount ? COLUMN_PIT_STOP_COUNT : 0;
+	columns |= before->crashed != after->crashed ? COLUMN_CRASHED : 0;
+	columns |= before->inStand != after->inStand ? COLUMN_IN_STAND : 0;
+	return columns;
+}
+
 int getRunningCars() {
 	int runningCars;
 
@@ -1419,48 +4935,72 @@ void decrementRunningCars() {
 
 	// relase exclusive access
 	sem_post(&sharedMemory->mutex);
+
+	// wake up the controller (it stops when no more car is running)
+	sem_post(&sharedMemory->dataReady);
 }
 
-// set race as over
+// set race as over (only the controller writes the flag, no lock needed)
 void setRaceAsOver() {
-	// get exclusive access to shared memory
-	sem_wait(&sharedMemory->mutex);
-
-	// set race as Over
-	sharedMemory->raceOver=true;
-
-	// relase exclusive access
-	sem_post(&sharedMemory->mutex);
+	atomic_store_explicit(&sharedMemory->raceOver, true, memory_order_release);
 }
 
+// read by the car simulators at each section: a single atomic load instead of the Courtois lock
 bool isRaceOver() {
-	bool isRaceOver;
-
-	readSharedMemoryData(&isRaceOver, RACE_OVER);
-
-	return isRaceOver;
+	return atomic_load_explicit(&sharedMemory->raceOver, memory_order_acquire);
 }
 
-void setCarTimeAndStatusAsProcessed(int i) {
-	// get exclusive access to shared memory
-	sem_wait(&sharedMemory->mutex);
+// publish all the updates done by one iteration of the controller:
+// - the changed columns of the CarStats (dirtyColumns) and the positions rankingFirst..rankingLast of the ranking
+//   are copied in a single write section of the sequence lock (readers always see a complete frame)
+// - raceOver = true if a car just reached the finish line
+// - the events read in each ring (consumed) are given back to the car simulators
+// - carStatsGeneration is incremented (in the write section, so a reader gets the generation of the data it read)
+//   and the screen manager is woken up
+// only the controller updates carStats, so the mutex is not needed: the sequence lock tells the readers to retry
+void commitControllerUpdates(const CarStat* carStats, const int* ranking, int rankingFirst, int rankingLast, const unsigned int* dirtyColumns, const int* consumed, int pilotRunning, bool raceOver) {
+	long long start = getMonotonicNanos();
+
+	// odd sequence: write in progress
+	unsigned int sequence = atomic_load_explicit(&sharedMemory->carStatsSequence, memory_order_relaxed);
+	atomic_store_explicit(&sharedMemory->carStatsSequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	// copy the changed fields of the cars
+	for (int i = 0; i < pilotRunning; i++) {
+		if (dirtyColumns[i]) {
+			sharedMemory->committedBytes += putCarStat(i, &carStats[i], dirtyColumns[i]);
+			sharedMemory->committedCarStats++;
+		}
+	}
+
+	// copy the positions changed in the running order
+	if (rankingFirst <= rankingLast) {
+		memcpy(&sharedMemory->ranking[rankingFirst], &ranking[rankingFirst], sizeof(int)*(rankingLast-rankingFirst+1));
+		sharedMemory->committedBytes += sizeof(int)*(rankingLast-rankingFirst+1);
+	}
 
-	// set processed to true
-	sharedMemory->carTimeAndStatuses[i].processed = true;
+	// new generation of the carStats
+	atomic_fetch_add_explicit(&sharedMemory->carStatsGeneration, 1, memory_order_relaxed);
 
-	// relase exclusive access
-	sem_post(&sharedMemory->mutex);
-}
+	// even sequence: write done, wake up the screen manager
+	atomic_store_explicit(&sharedMemory->carStatsSequence, sequence + 2, memory_order_release);
+	sem_post(&sharedMemory->screenWakeup);
 
-void updateCarStat(CarStat carStat, int i) {
-	// get exclusive access to shared memory
-	sem_wait(&sharedMemory->mutex);
+	if (raceOver) {
+		setRaceAsOver();
+	}
 
-	// set processed to true
-	memcpy(&(sharedMemory->carStats[i]),&carStat,sizeof(CarStat));
+	// free the slots of the processed events (more credits for the car simulators)
+	for (int i = 0; i < pilotRunning; i++) {
+		if (consumed[i] > 0) {
+			CarEventRing* ring = &sharedMemory->carEventRings[i];
+			unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+			atomic_store_explicit(&ring->tail, tail + consumed[i], memory_order_release);
+		}
+	}
 
-	// relase exclusive access
-	sem_post(&sharedMemory->mutex);
+	addLatency(&sharedMemory->carStatCommit, getMonotonicNanos() - start);
 }
 
 // -------------------------------------------------------------
@@ -1497,59 +5037,251 @@ enum RacePhase getNextPhase(enum RacePhase currentPhase, bool special) {
 			case RACE: return FINISH;
 			default: return FINISH;
 		}
-	} else {
-		switch (currentPhase) {
-			case START_OF_WEEKEND: return FREE_PRACTICE_1;
-			case FREE_PRACTICE_1: return SPRINT_QUALIFICATION_1;
-			case SPRINT_QUALIFICATION_1: return SPRINT_QUALIFICATION_2;
-			case SPRINT_QUALIFICATION_2: return SPRINT_QUALIFICATION_3;
-			case SPRINT_QUALIFICATION_3: return SPRINT;
-			case SPRINT: return QUALIFICATION_1;
-			case QUALIFICATION_1: return QUALIFICATION_2;
-			case QUALIFICATION_2: return QUALIFICATION_3;
-			case QUALIFICATION_3: return RACE;
-			case RACE: return FINISH;
-			default: return FINISH;
+	} else {
+		switch (currentPhase) {
+			case START_OF_WEEKEND: return FREE_PRACTICE_1;
+			case FREE_PRACTICE_1: return SPRINT_QUALIFICATION_1;
+			case SPRINT_QUALIFICATION_1: return SPRINT_QUALIFICATION_2;
+			case SPRINT_QUALIFICATION_2: return SPRINT_QUALIFICATION_3;
+			case SPRINT_QUALIFICATION_3: return SPRINT;
+			case SPRINT: return QUALIFICATION_1;
+			case QUALIFICATION_1: return QUALIFICATION_2;
+			case QUALIFICATION_2: return QUALIFICATION_3;
+			case QUALIFICATION_3: return RACE;
+			case RACE: return FINISH;
+			default: return FINISH;
+		}
+    }
+}
+
+// special == true if week-end includes a SPRINT race
+enum RacePhase getPreviousPhase(enum RacePhase currentPhase, bool special) {
+    if (!special) {
+		switch (currentPhase) {
+			case FREE_PRACTICE_1: return START_OF_WEEKEND;
+			case FREE_PRACTICE_2: return FREE_PRACTICE_1;
+			case FREE_PRACTICE_3: return FREE_PRACTICE_2;
+			case QUALIFICATION_1: return FREE_PRACTICE_3;
+			case QUALIFICATION_2: return QUALIFICATION_1;
+			case QUALIFICATION_3: return QUALIFICATION_2;
+			case RACE: return QUALIFICATION_3;
+			case FINISH: return RACE;
+		}
+	} else {
+		switch (currentPhase) {
+			case FREE_PRACTICE_1: return START_OF_WEEKEND;
+			case SPRINT_QUALIFICATION_1: return FREE_PRACTICE_1;
+			case SPRINT_QUALIFICATION_2: return SPRINT_QUALIFICATION_1;
+			case SPRINT_QUALIFICATION_3: return SPRINT_QUALIFICATION_2;
+			case SPRINT: return SPRINT_QUALIFICATION_3;
+			case QUALIFICATION_1: return SPRINT;
+			case QUALIFICATION_2: return QUALIFICATION_1;
+			case QUALIFICATION_3: return QUALIFICATION_2;
+			case RACE: return QUALIFICATION_3;
+			case FINISH: return RACE;
+		}
+    }
+}
+
+// Read championship.txt to determine last race and phase done
+void loadChampionshipState(int* raceNumber, enum RacePhase* phase) {
+	FILE *file = fopen("championship.txt","r");
+	if (!file) {
+		// file does not exist, championship not yet started
+		*raceNumber = 0;
+		*phase = START_OF_WEEKEND;
+	} else {
+		// Championship started, read race number and phase
+		int iPhase;
+		if (!fscanf(file, "race=%d\nphase=%d", raceNumber,&iPhase)) {
+			// file content is invalid, start all over
+			*raceNumber=0;
+			*phase=FREE_PRACTICE_1;
+		} else {
+			// raceNumber is already read
+			*phase=(enum RacePhase)iPhase;
+		}
+		fclose(file);
+	}
+}
+
+// get next phase or race, return false if the championship is over
+bool getNextSession(int* raceNumber, enum RacePhase* phase) {
+	if (*phase == RACE) {
+		if (*raceNumber + 1 == MAX_TRACK) {
+			return false;
+		}
+		(*raceNumber)++;
+		*phase=FREE_PRACTICE_1;
+	} else {
+		*phase=getNextPhase(*phase,tracks[*raceNumber].sprint);
+	}
+	return true;
+}
+
+// Save championship data (last race and phase done)
+void saveChampionshipState(int raceNumber, enum RacePhase phase) {
+	FILE *file = fopen("championship.txt","w");
+	if (!file) {
+		// error while creating the file
+		perror("Unable to save championship.txt");
+		exit(1);
+	} else {
+		// Save data
+		fprintf(file,"race=%d\nphase=%d\n",raceNumber,phase);
+	}
+	fclose(file);
+}
+
+// prepare the shared memory for a new session (before the launch of the controller and car simulators)
+void initSessionData(int raceNumber, enum RacePhase phase, int pilotRunning) {
+	memset(sharedMemory->carEventRings, 0, sizeof(CarEventRing) * pilotCount);
+	CarStat* carStats = calloc(pilotCount, sizeof(CarStat));
+	if (!carStats) {
+		perror("Unable to allocate the CarStats");
+		exit(1);
+	}
+
+	// if in free practice or qualification 1 => all pilots are running, we don't care in which order)
+	if (phase == FREE_PRACTICE_1 || phase == FREE_PRACTICE_2 || phase == FREE_PRACTICE_3
+		|| phase == QUALIFICATION_1 || phase == SPRINT_QUALIFICATION_1) {
+		for (int i=0;i<pilotCount;i++) {
+			carStats[i].pilotNumber = drivers[i].id;
+			carStats[i].inStand = true;
+		}
+	} else {
+		// we are in qualification 2/3 or sprint or race, order is important and based on previous result
+		enum RacePhase previousPhase = getPreviousPhase(phase, tracks[raceNumber].sprint);
+		loadPhaseResult(carStats, raceNumber, previousPhase);
+	}
+
+	// best lap and sections time are set to 999.999
+	for (int i=0;i<pilotCount;i++) {
+		initCarStatTimes(&carStats[i]);
+		putCarStat(i, &carStats[i], COLUMN_ALL);
+	}
+	free(carStats);
+
+	// no time yet, so the running order is the order of the grid
+	initRanking(sharedMemory->ranking, NULL, pilotCount);
+
+	// All event rings are empty (head == tail), so each car simulator has CAR_EVENT_RING_SIZE credits
+	for (int i = 0; i < pilotCount; i++) {
+		atomic_init(&sharedMemory->carEventRings[i].head, 0);
+		atomic_init(&sharedMemory->carEventRings[i].tail, 0);
+	}
+
+	sharedMemory->runningCars = pilotRunning;
+	atomic_init(&sharedMemory->raceOver, false);
+	atomic_init(&sharedMemory->carStatsSequence, 0);
+	atomic_init(&sharedMemory->carStatsGeneration, 0);
+	atomic_init(&sharedMemory->controllerDone, false);
+}
+
+// save phase result, sprint/race ranking and championship data
+// seed = seed of the session
+void saveSessionResult(int raceNumber, enum RacePhase phase, uint64_t seed) {
+	savePhaseResult(raceNumber, phase, seed);
+
+	// save sprint/race ranking
+	if (phase == RACE || phase == SPRINT) {
+		saveChampionshipResult(raceNumber, phase);
+	}
+
+	saveChampionshipState(raceNumber, phase);
+
+	// the session is over, it can't be resumed anymore
+	removeCheckpoint(raceNumber, phase);
+}
+
+// --headless: simulate the next sessions with the discrete event engine (virtual clock, no wait, no screen)
+// the same files are created as with the normal mode
+void runHeadless() {
+	int raceNumber;
+	enum RacePhase phase;
+	// the engine works on its own copy of the CarStats, stored back at the end of each session
+	CarSimulatorState* cars = malloc(pilotCount * sizeof(CarSimulatorState));
+	CarStat* carStats = malloc(pilotCount * sizeof(CarStat));
+	if (!cars || !carStats) {
+		perror("Unable to allocate the cars");
+		exit(1);
+	}
+
+	loadChampionshipState(&raceNumber, &phase);
+	createSharedMemory();
+	long long start = getMonotonicNanos();
+	int session;
+	for (session = 0; options.sessions == 0 || session < options.sessions; session++) {
+		if (!getNextSession(&raceNumber, &phase)) {
+			printf("Championship is over\n");
+			break;
+		}
+
+		int pilotRunning = getMaxPilotRunning(phase);
+		uint64_t seed = nextSessionSeed();
+		initSessionData(raceNumber, phase, pilotRunning);
+
+		// same cars as the car simulators launched by main
+		for (int i = 0; i < pilotRunning; i++) {
+			// delay is used to simulate position on the track when starting a race.  Ignored if free practise or qualification
+			CarTime delay = i * 500 * CAR_TIME_MILLISECOND;
+			initCarSimulator(&cars[i], i, delay, raceNumber, phase, seed);
 		}
-    }
-}
 
-// special == true if week-end includes a SPRINT race
-enum RacePhase getPreviousPhase(enum RacePhase currentPhase, bool special) {
-    if (!special) {
-		switch (currentPhase) {
-			case FREE_PRACTICE_1: return START_OF_WEEKEND;
-			case FREE_PRACTICE_2: return FREE_PRACTICE_1;
-			case FREE_PRACTICE_3: return FREE_PRACTICE_2;
-			case QUALIFICATION_1: return FREE_PRACTICE_3;
-			case QUALIFICATION_2: return QUALIFICATION_1;
-			case QUALIFICATION_3: return QUALIFICATION_2;
-			case RACE: return QUALIFICATION_3;
-			case FINISH: return RACE;
+		long long sessionStart = getMonotonicNanos();
+		long long virtualTime;
+		readCarStats(carStats, NULL);
+		int maxLap = getTrackLap(raceNumber, phase);
+		Journal* journal = openJournal(raceNumber, phase, maxLap, carStats, pilotRunning, seed, NULL);
+		long long eventCount = runDiscreteEventSession(cars, carStats, sharedMemory->ranking, pilotRunning, phase, maxLap, &virtualTime, journal);
+		if (journal) {
+			closeJournal(journal);
+			free(journal);
 		}
-	} else {
-		switch (currentPhase) {
-			case FREE_PRACTICE_1: return START_OF_WEEKEND;
-			case SPRINT_QUALIFICATION_1: return FREE_PRACTICE_1;
-			case SPRINT_QUALIFICATION_2: return SPRINT_QUALIFICATION_1;
-			case SPRINT_QUALIFICATION_3: return SPRINT_QUALIFICATION_2;
-			case SPRINT: return SPRINT_QUALIFICATION_3;
-			case QUALIFICATION_1: return SPRINT;
-			case QUALIFICATION_2: return QUALIFICATION_1;
-			case QUALIFICATION_3: return QUALIFICATION_2;
-			case RACE: return QUALIFICATION_3;
-			case FINISH: return RACE;
+		for (int i = 0; i < pilotRunning; i++) {
+			putCarStat(i, &carStats[i], COLUMN_ALL);
 		}
-    }
+		sharedMemory->runningCars = 0;
+
+		saveSessionResult(raceNumber, phase, seed);
+
+		printf("Race #%d - %s: %lld events, %.3f ms, seed %llu\n", raceNumber+1, racePhaseToString(phase), eventCount,
+			(getMonotonicNanos() - sessionStart) / 1000000.0, (unsigned long long)seed);
+	}
+	printf("%d sessions simulated in %.3f ms\n", session, (getMonotonicNanos() - start) / 1000000.0);
+	free(cars);
+	free(carStats);
+
+	cleanupSharedMemory(0);
+}
+
+// return the number of lines of the terminal (0 if unknown, i.e. output is not a terminal)
+int getTerminalRows() {
+	struct winsize w;
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1) {
+		return 0;
+	}
+	return w.ws_row;
 }
 
-// display pilot ranking
-void displayRanking(int raceNumber) {
-	PilotStat pilotStats[MAX_PILOT];
+// display pilot ranking (only the pilots that fit in the terminal), return the line below the ranking
+int displayRanking(int raceNumber) {
+	PilotStat* pilotStats = malloc(pilotCount * sizeof(PilotStat));
+	if (!pilotStats) {
+		perror("Unable to allocate the ranking");
+		exit(1);
+	}
 
 	// load all previous data
 	loadFinalChampionshipResult(raceNumber, pilotStats, drivers);
-	qsort(pilotStats, MAX_PILOT, sizeof(PilotStat), comparePilotStat);
+	qsort(pilotStats, pilotCount, sizeof(PilotStat), comparePilotStat);
+
+	// 15 lines above the ranking, 1 line at the bottom
+	int displayRows = pilotCount;
+	int terminalRows = getTerminalRows();
+	if (terminalRows > 16 && displayRows > terminalRows - 16) {
+		displayRows = terminalRows - 16;
+	}
 
 	printf("\033[11;10H┌─────────────────┐");
 	printf("\033[12;10H│ Pilot's ranking │");
@@ -1557,7 +5289,7 @@ void displayRanking(int raceNumber) {
 	printf("\033[14;10H│ Pos │ Name                         │ total │ Race won │");
 	printf("\033[15;10H├─────┼──────────────────────────────┼───────┼──────────┤");
 	int pos=1;
-	for (int i=0;i<MAX_PILOT;i++) {
+	for (int i=0;i<displayRows;i++) {
 		if (i>0 && pilotStats[i].score == pilotStats[i-1].score && pilotStats[i].raceWon == pilotStats[i-1].raceWon) {
 			// equality, driver is at same position in ranking
 		} else {
@@ -1566,8 +5298,336 @@ void displayRanking(int raceNumber) {
 		printf("\033[%d;10H│ %3d │ %s", 16+i, pos, pilotStats[i].name);
 		printf("\033[%d;47H│ %5d │ %8d │", 16+i, pilotStats[i].score, pilotStats[i].raceWon);
 	}
-	printf("\033[36;10H└─────┴──────────────────────────────┴───────┴──────────┘\n");
+	printf("\033[%d;10H└─────┴──────────────────────────────┴───────┴──────────┘\n", 16+displayRows);
+	fflush(stdout);
+	free(pilotStats);
+
+	return 17+displayRows;
+}
+
+// display statistics about the session (below the pilot ranking)
+// row = 1st line of the report, startupNanos = time to launch all the workers, peakRssKb = peak memory used by all the processes (or threads)
+void displaySessionReport(int row, int pilotRunning, long long startupNanos, long peakRssKb, uint64_t seed) {
+	// event rings: highest depth and number of time a car simulator had no credit left
+	unsigned int maxDepth = 0;
+	unsigned int creditStalls = 0;
+	int maxDepthCar = 0;
+	for (int i=0;i<pilotRunning;i++) {
+		if (sharedMemory->carEventRings[i].maxDepth > maxDepth) {
+			maxDepth = sharedMemory->carEventRings[i].maxDepth;
+			maxDepthCar = i;
+		}
+		creditStalls += sharedMemory->carEventRings[i].creditStalls;
+	}
+
+	printf("\033[%d;10H Event queues: max depth %u/%d (%d-%s), credit stalls: %u\n",
+		row+1, maxDepth, CAR_EVENT_RING_SIZE,
+		sharedMemory->carStats.pilotNumber[maxDepthCar], getDriverShortName(sharedMemory->carStats.pilotNumber[maxDepthCar]),
+		creditStalls);
+
+	// controller wake-ups and latency between publication and processing of an event
+	LatencyStat latency = sharedMemory->eventLatency;
+	printf("\033[%d;10H Controller: %lld wake-ups, event latency avg %.3f ms, max %.3f ms\n",
+		row+2, sharedMemory->controllerWakeups,
+		latency.count ? latency.totalNanos / (double)latency.count / 1000000.0 : 0.0,
+		latency.maxNanos / 1000000.0);
+
+	// time spent by the controller to publish its updates
+	latency = sharedMemory->carStatCommit;
+	long long eventCount = sharedMemory->eventLatency.count;
+	printf("\033[%d;10H Controller commits: %lld (%lld CarStats), avg %.3f us, max %.3f us, %.1f bytes written per event (CarStat: %zu bytes)\n",
+		row+3, latency.count, sharedMemory->committedCarStats,
+		latency.count ? latency.totalNanos / (double)latency.count / 1000.0 : 0.0,
+		latency.maxNanos / 1000.0, eventCount ? sharedMemory->committedBytes / (double)eventCount : 0.0, sizeof(CarStat));
+
+	// cost of the execution mode
+	printf("\033[%d;10H Execution: %s, startup %.3f ms, peak RSS %ld kB, seed %llu\n",
+		row+4, options.threads ? "threads" : "processes", startupNanos / 1000000.0, peakRssKb, (unsigned long long)seed);
+
+	// cost of the display (frames without any change are skipped)
+	printf("\033[%d;10H Screen: %d fps max, %lld wake-ups, %lld frames drawn, %lld skipped, %.1f bytes per frame, CPU %.3f ms\n",
+		row+5, options.fps, sharedMemory->screenWakeups, sharedMemory->screenFrames, sharedMemory->screenSkippedFrames,
+		sharedMemory->screenFrames ? sharedMemory->screenBytes / (double)sharedMemory->screenFrames : 0.0,
+		sharedMemory->screenCpuNanos / 1000000.0);
+
+	// events saved by the journal writer thread
+	if (options.noJournal) {
+		printf("\033[%d;10H Journal: disabled\n", row+6);
+	} else {
+		printf("\033[%d;10H Journal: %lld events (%zu bytes each), %lld blocks of %d bytes written, %lld events dropped, %lld checkpoints (avg %.3f ms)%s\n",
+			row+6, sharedMemory->journalEvents, sizeof(JournalRecord), sharedMemory->journalWrites, JOURNAL_BLOCK_SIZE, sharedMemory->journalDropped,
+			sharedMemory->checkpoints, sharedMemory->checkpoints ? sharedMemory->checkpointNanos / (double)sharedMemory->checkpoints / 1000000.0 : 0.0,
+			resumeCheckpoint.header ? ", resumed" : "");
+	}
+
+	// how precisely each car simulator followed its deadlines
+	printf("\033[%d;10H Car deadlines (speed x%d): wake-up lateness avg/max, drift at the end\n", row+8, options.speed);
+	// only the cars that fit in the terminal
+	int carRows = pilotRunning;
+	int terminalRows = getTerminalRows();
+	if (terminalRows > row+9 && carRows > terminalRows - (row+9)) {
+		carRows = terminalRows - (row+9);
+	}
+	for (int i=0;i<carRows;i++) {
+		CarEventRing* ring = &sharedMemory->carEventRings[i];
+		LatencyStat lateness = ring->deadlineLateness;
+		printf("\033[%d;10H  %3s: %5lld wake-ups, late avg %.3f ms, max %.3f ms, drift %+.3f ms\n",
+			row+9+i, getDriverShortName(sharedMemory->carStats.pilotNumber[i]), lateness.count,
+			lateness.count ? lateness.totalNanos / (double)lateness.count / 1000000.0 : 0.0,
+			lateness.maxNanos / 1000000.0, ring->driftNanos / 1000000.0);
+	}
+	fflush(stdout);
+}
+
+// -------------------------------------------------------------
+// Workers: controller, car simulators and screen manager
+// they are started as child processes (fork), or as threads with --threads
+
+// execute the worker
+void runWorker(const WorkerArgs* args) {
+	switch (args->type) {
+		case CONTROLLER_WORKER:
+			controller(args->raceNumber, args->phase, args->pilotRunning, args->seed);
+			break;
+		case CAR_SIMULATOR_WORKER:
+			carSimulator(args->id, args->delay, args->raceNumber, args->phase, args->seed);
+			break;
+		case SCREEN_MANAGER_WORKER:
+			screenManager(args->phase, args->pilotRunning);
+			break;
+	}
+}
+
+// start function of a worker thread
+void* workerThread(void* args) {
+	runWorker((const WorkerArgs*)args);
+	return NULL;
+}
+
+// start the worker in a child process (args->pid is then set), or in a thread (thread is then set)
+// args must stay valid until the worker is stopped, return false if the worker could not be started
+bool launchWorker(WorkerArgs* args, pthread_t* thread) {
+	if (options.threads) {
+		if (pthread_create(thread, NULL, workerThread, args) != 0) {
+			perror("Unable to start thread");
+			return false;
+		}
+		return true;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		// execute the worker in the child process
+		runWorker(args);
+		exit(0);
+	} else if (pid == -1) {
+		perror("Unable to start process");
+		return false;
+	}
+	args->pid = pid;
+	return true;
+}
+
+// stop the workers already started when the others could not be started: the session is abandoned
+// a child process detaches from the shared memory on SIGTERM (see cleanupSharedMemory), a thread is cancelled
+void stopWorkers(WorkerArgs* workers, pthread_t* threads, int workerCount) {
+	for (int i = 0; i < workerCount; i++) {
+		if (options.threads) {
+			pthread_cancel(threads[i]);
+			pthread_join(threads[i], NULL);
+		} else {
+			kill(workers[i].pid, SIGTERM);
+			waitpid(workers[i].pid, NULL, 0);
+		}
+	}
+}
+
+// -------------------------------------------------------------
+// Benchmark of the shared memory layout
+// all car simulators publish at the same time: each one moves the head of its ring and updates its statistics,
+// while the controller reads all heads and moves the tails.
+// The same work is done with the control words packed (as with COMPACT_SHM_LAYOUT) and with 1 cache line per writer,
+// the difference of time is the cost of the cache lines bouncing between the cores.
+
+// control words of 1 ring, packed: 4 cars share the same cache line
+typedef struct {
+	atomic_uint head;
+	atomic_uint tail;
+	unsigned int maxDepth;
+	unsigned int creditStalls;
+} PackedRingControl;
+
+// control words of 1 ring, padded: the car simulator and the controller have their own cache line
+typedef struct {
+	_Alignas(CACHE_LINE_SIZE) atomic_uint head;
+	unsigned int maxDepth;
+	unsigned int creditStalls;
+	_Alignas(CACHE_LINE_SIZE) atomic_uint tail;
+} PaddedRingControl;
+
+// run 1 benchmark: fork 1 publisher per car + 1 consumer, return the duration in nanoseconds
+// heads/tails/maxDepths point to the fields of car 0, stride is the size of the struct of 1 car
+long long benchmarkRingControls(char* rings, size_t stride, size_t headOffset, size_t tailOffset, size_t maxDepthOffset, int iterations) {
+	atomic_int* carsDone = (atomic_int*)(rings + stride * BENCH_LAYOUT_CARS);
+	atomic_init(carsDone, 0);
+
+	// childs must not print again what is still in the buffer
 	fflush(stdout);
+
+	long long start = getMonotonicNanos();
+
+	// consumer (controller): read all heads, move tails
+	pid_t consumerPid = fork();
+	if (consumerPid == 0) {
+		while (atomic_load_explicit(carsDone, memory_order_acquire) < BENCH_LAYOUT_CARS) {
+			for (int i = 0; i < BENCH_LAYOUT_CARS; i++) {
+				atomic_uint* head = (atomic_uint*)(rings + stride * i + headOffset);
+				atomic_uint* tail = (atomic_uint*)(rings + stride * i + tailOffset);
+				unsigned int h = atomic_load_explicit(head, memory_order_acquire);
+				if (h != atomic_load_explicit(tail, memory_order_relaxed)) {
+					atomic_store_explicit(tail, h, memory_order_release);
+				}
+			}
+		}
+		exit(0);
+	}
+
+	// publishers (car simulators): move head, update max depth
+	for (int i = 0; i < BENCH_LAYOUT_CARS; i++) {
+		if (fork() == 0) {
+			atomic_uint* head = (atomic_uint*)(rings + stride * i + headOffset);
+			atomic_uint* tail = (atomic_uint*)(rings + stride * i + tailOffset);
+			unsigned int* maxDepth = (unsigned int*)(rings + stride * i + maxDepthOffset);
+			for (int n = 0; n < iterations; n++) {
+				unsigned int h = atomic_load_explicit(head, memory_order_relaxed) + 1;
+				atomic_store_explicit(head, h, memory_order_release);
+				unsigned int depth = h - atomic_load_explicit(tail, memory_order_acquire);
+				if (depth > *maxDepth) {
+					*maxDepth = depth;
+				}
+			}
+			atomic_fetch_add_explicit(carsDone, 1, memory_order_release);
+			exit(0);
+		}
+	}
+
+	while (wait(NULL) > 0);
+
+	return getMonotonicNanos() - start;
+}
+
+void benchmarkSharedMemoryLayout(int iterations) {
+	// shared between the forked processes, big enough for the padded layout + 1 counter
+	size_t size = sizeof(PaddedRingControl) * (BENCH_LAYOUT_CARS + 1);
+	char* rings = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (rings == MAP_FAILED) {
+		perror("Unable to allocate benchmark memory");
+		exit(1);
+	}
+
+	printf("Shared memory layout benchmark: %d cars x %d events, %ld cores, layout compiled: %s\n",
+		BENCH_LAYOUT_CARS, iterations, sysconf(_SC_NPROCESSORS_ONLN),
+#ifdef COMPACT_SHM_LAYOUT
+		"compact"
+#else
+		"cache line aligned"
+#endif
+		);
+
+	memset(rings, 0, size);
+	long long packed = benchmarkRingControls(rings, sizeof(PackedRingControl),
+		offsetof(PackedRingControl, head), offsetof(PackedRingControl, tail), offsetof(PackedRingControl, maxDepth), iterations);
+	printf(" packed  (%3zu bytes/car): %8.3f ms, %6.2f ns/event\n", sizeof(PackedRingControl),
+		packed / 1000000.0, packed / (double)iterations / BENCH_LAYOUT_CARS);
+
+	memset(rings, 0, size);
+	long long padded = benchmarkRingControls(rings, sizeof(PaddedRingControl),
+		offsetof(PaddedRingControl, head), offsetof(PaddedRingControl, tail), offsetof(PaddedRingControl, maxDepth), iterations);
+	printf(" padded  (%3zu bytes/car): %8.3f ms, %6.2f ns/event\n", sizeof(PaddedRingControl),
+		padded / 1000000.0, padded / (double)iterations / BENCH_LAYOUT_CARS);
+
+	printf(" packed/padded: %.2fx\n", (double)packed / padded);
+
+	munmap(rings, size);
+}
+
+// -------------------------------------------------------------
+// read command line options
+void parseOptions(int argc, char *argv[]) {
+	memset(&options, 0, sizeof(options));
+	options.sessions = 1;
+	options.speed = 60;
+	options.fps = 1;
+	options.checkpointSeconds = 5;
+	// default seed: different for each run (--seed to replay a session)
+	options.seed = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getMonotonicNanos() ^ (uint64_t)getpid();
+	bool checkpointOption = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench-layout") == 0) {
+			options.benchLayout = true;
+		} else if (strcmp(argv[i], "--bench-sort") == 0) {
+			options.benchSort = true;
+		} else if (strcmp(argv[i], "--self-test") == 0) {
+			options.selfTest = true;
+		} else if (strcmp(argv[i], "--no-csv") == 0) {
+			options.noCsv = true;
+		} else if (strcmp(argv[i], "--export-csv") == 0) {
+			options.exportCsv = true;
+		} else if (strcmp(argv[i], "--rebuild-standings") == 0) {
+			options.rebuildStandings = true;
+		} else if (strcmp(argv[i], "--no-journal") == 0) {
+			options.noJournal = true;
+		} else if (strcmp(argv[i], "--journal") == 0 && i+1 < argc) {
+			options.analyzeJournal = argv[++i];
+		} else if (strcmp(argv[i], "--checkpoint") == 0 && i+1 < argc && atoi(argv[i+1]) >= 0) {
+			options.checkpointSeconds = atoi(argv[++i]);
+			checkpointOption = true;
+		} else if (strcmp(argv[i], "--resume") == 0) {
+			options.resume = true;
+		} else if (strcmp(argv[i], "--replay") == 0 && i+1 < argc) {
+			options.replay = argv[++i];
+		} else if (strcmp(argv[i], "--seek") == 0 && i+1 < argc && atoi(argv[i+1]) >= 0) {
+			// the position of the replay is in milliseconds (int): a longer seek goes to the end of the session
+			options.replaySeekSeconds = atoi(argv[++i]);
+			if (options.replaySeekSeconds > INT32_MAX / 1000) {
+				options.replaySeekSeconds = INT32_MAX / 1000;
+			}
+		} else if (strcmp(argv[i], "--scan") == 0) {
+			options.scanJournals = true;
+		} else if (strcmp(argv[i], "--threads") == 0) {
+			options.threads = true;
+		} else if (strcmp(argv[i], "--stress") == 0 && i+1 < argc && atoi(argv[i+1]) > 0) {
+			options.stressCars = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--fps") == 0 && i+1 < argc && atoi(argv[i+1]) >= 1 && atoi(argv[i+1]) <= 30) {
+			options.fps = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--speed") == 0 && i+1 < argc && atoi(argv[i+1]) >= 1 && atoi(argv[i+1]) <= 1000) {
+			options.speed = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--q2-cut") == 0 && i+1 < argc && atoi(argv[i+1]) > 0) {
+			options.q2Cut = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--q3-cut") == 0 && i+1 < argc && atoi(argv[i+1]) > 0) {
+			options.q3Cut = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--projection") == 0 && i+1 < argc && atoi(argv[i+1]) > 0) {
+			options.projectionSeasons = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i+1 < argc) {
+			options.seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--bench-sections") == 0 && i+1 < argc && atoi(argv[i+1]) > 0) {
+			options.benchSectionCars = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			options.headless = true;
+		} else if (strcmp(argv[i], "--sessions") == 0 && i+1 < argc && atoi(argv[i+1]) >= 0) {
+			options.sessions = atoi(argv[++i]);
+		} else {
+			printf("Unknown option '%s'\n", argv[i]);
+			printf("Usage: %s [--threads] [--speed 1-1000] [--fps 1-30] [--q2-cut n] [--q3-cut n] [--headless [--sessions n]] [--projection seasons] [--seed n] [--no-csv] [--export-csv] [--rebuild-standings] [--no-journal] [--journal file] [--checkpoint seconds] [--resume] [--replay file [--seek seconds]] [--scan] [--bench-layout] [--bench-sort] [--stress cars] [--bench-sections cars] [--self-test]\n", argv[0]);
+			exit(1);
+		}
+	}
+
+	// the checkpoints are written by the thread of the journal
+	if (options.noJournal && (checkpointOption || options.resume)) {
+		fprintf(stderr, "Warning: no checkpoint with --no-journal (the checkpoints are saved with the journal)\n");
+	}
 }
 
 /**
@@ -1576,11 +5636,100 @@ void displayRanking(int raceNumber) {
  * ======================================================================================
 */
 int main(int argc, char *argv[]) {
+	// Read command line
+	parseOptions(argc, argv);
+	if (options.benchLayout) {
+		benchmarkSharedMemoryLayout(1000000);
+		return 0;
+	}
+	if (options.benchSort) {
+		return benchmarkCarSort() ? 0 : 1;
+	}
+	if (options.exportCsv) {
+		exportResultCsv();
+		return 0;
+	}
+
 	// Read track data
 	readTrackData(tracks);
 
-	// Read driver data
-	readDriverData(drivers);
+	if (options.benchSectionCars > 0) {
+		return benchmarkSectionKernel(options.benchSectionCars) ? 0 : 1;
+	}
+
+	if (options.selfTest) {
+		return selfTest() ? 0 : 1;
+	}
+
+	if (options.stressCars > 0) {
+		stressTest(options.stressCars);
+		return 0;
+	}
+
+	// Read driver data, the size of the grid is the number of pilots
+	drivers = readDriverData(&pilotCount);
+	if (pilotCount == 0) {
+		printf("No pilot in drivers.csv\n");
+		exit(1);
+	}
+	// the car of a journal record is a uint16_t
+	if (pilotCount > UINT16_MAX + 1 && !options.noJournal) {
+		fprintf(stderr, "Warning: no journal with %d pilots (at most %d)\n", pilotCount, UINT16_MAX + 1);
+		options.noJournal = true;
+	}
+
+	// number of pilots qualified for Q2/Q3 (15 and 10 with a grid of 20), at least 1 with a small grid
+	if (options.q2Cut == 0) {
+		options.q2Cut = pilotCount * 3 / 4 > 0 ? pilotCount * 3 / 4 : 1;
+	}
+	if (options.q3Cut == 0) {
+		options.q3Cut = pilotCount / 2 > 0 ? pilotCount / 2 : 1;
+	}
+	if (options.q2Cut > pilotCount || options.q3Cut > options.q2Cut || options.q3Cut < 1) {
+		printf("Invalid knockout: %d pilots, %d in Q2, %d in Q3\n", pilotCount, options.q2Cut, options.q3Cut);
+		exit(1);
+	}
+
+	if (options.analyzeJournal) {
+		analyzeJournal(options.analyzeJournal);
+		return 0;
+	}
+
+	if (options.replay) {
+		runReplay(options.replay);
+		return 0;
+	}
+
+	if (options.scanJournals) {
+		return scanJournals() > 0 ? 1 : 0;
+	}
+
+	if (options.rebuildStandings) {
+		int raceNumber;
+		enum RacePhase phase;
+		loadChampionshipState(&raceNumber, &phase);
+		StandingsFileHeader header;
+		StandingsRecord* records = malloc(pilotCount * sizeof(StandingsRecord));
+		if (!records) {
+			perror("Unable to rebuild standings.bin");
+			exit(1);
+		}
+		rebuildStandings(getStandingsRound(raceNumber, RACE), &header, records);
+		writeStandings(&header, records);
+		free(records);
+		printf("standings.bin rebuilt: %d rounds\n", __builtin_popcountll(header.appliedRounds));
+		return 0;
+	}
+
+	if (options.projectionSeasons > 0) {
+		projectChampionship(options.projectionSeasons);
+		return 0;
+	}
+
+	if (options.headless) {
+		runHeadless();
+		return 0;
+	}
 
 	// variable to store where we are in the championship
 	int raceNumber;
@@ -1590,24 +5739,7 @@ int main(int argc, char *argv[]) {
 	// displayLogo();
 
 	// Read championship.txt to determine last race and phase done
-	FILE *file = fopen("championship.txt","r");
-	if (!file) {
-		// file does not exist, championship not yet started
-		raceNumber = 0;
-		phase = START_OF_WEEKEND;
-	} else {
-		// Championship started, read race number and phase
-		int iPhase;
-		if (!fscanf(file, "race=%d\nphase=%d", &raceNumber,&iPhase)) {
-			// file content is invalid, start all over
-			raceNumber=0;
-			phase=FREE_PRACTICE_1;
-		} else {
-			// raceNumber is already read
-			phase=(enum RacePhase)iPhase;
-		}
-		fclose(file);
-	}
+	loadChampionshipState(&raceNumber, &phase);
 
 	printf("\033[2J"); // clear screen
 	printf("\033[1;1H┌──────────────────────────────────────────────────────┐");
@@ -1615,18 +5747,22 @@ int main(int argc, char *argv[]) {
 	printf("\033[3;1H└──┬───────────────────────────────────────────────────┴──────────────────────┐");
 
 	// get next phase or race
-	if (phase == RACE) {
-		raceNumber++;
-		if (raceNumber == 22) {
-			printf("   !!! Championship is over !!!");
-			exit(0);
-		}
-		phase=FREE_PRACTICE_1;
-	} else {
-		phase=getNextPhase(phase,tracks[raceNumber].sprint);
+	if (!getNextSession(&raceNumber, &phase)) {
+		printf("   !!! Championship is over !!!");
+		exit(0);
+	}
+	if (options.resume && !loadCheckpoint(raceNumber, phase, &resumeCheckpoint)) {
+		printf("\033[4;1H   No checkpoint to resume for race #%d - %s\n", raceNumber+1, racePhaseToString(phase));
+		exit(1);
 	}
 	printf("\033[4;1H   │ Race #%d - '%s' - '%s'",raceNumber+1, tracks[raceNumber].country, tracks[raceNumber].name);
-	printf("\033[5;1H   │ Phase: '%s'",racePhaseToString(phase));
+	if (resumeCheckpoint.header) {
+		int resumeMillis = resumeCheckpoint.header->sessionMillis;
+		printf("\033[5;1H   │ Phase: '%s' (resumed at %d:%02d:%02d)",racePhaseToString(phase),
+			resumeMillis / 3600000, (resumeMillis / 60000) % 60, (resumeMillis / 1000) % 60);
+	} else {
+		printf("\033[5;1H   │ Phase: '%s'",racePhaseToString(phase));
+	}
 	printf("\033[4;79H│");
 	printf("\033[5;79H│");
 
@@ -1672,121 +5808,106 @@ int main(int argc, char *argv[]) {
 	int pilotRunning=getMaxPilotRunning(phase);
 
 	// Create shared memory
-	int shmid = shmget(SHM_KEY, sizeof(SharedMemory), IPC_CREAT | 0666);
-	if (shmid == -1) {
-		perror("Error when creating shared memory");
-		exit(EXIT_FAILURE);
-	}
-
-	sharedMemory = (SharedMemory *)shmat(shmid, NULL, 0);
-	if (sharedMemory == (void *)-1) {
-		perror("Error when attaching to shared memory");
-		exit(EXIT_FAILURE);
-	}
+	createSharedMemory();
 
-	// if program is stopped using CTRL+C, will make sure to cleanup shared memory
+	// if program is stopped using CTRL+C or kill, will make sure to cleanup shared memory
 	signal(SIGINT, cleanupSharedMemory);
+	signal(SIGTERM, cleanupSharedMemory);
 
 	// Initialize shared memory
-	memset(sharedMemory->carTimeAndStatuses, 0, sizeof(sharedMemory->carTimeAndStatuses));
-	memset(sharedMemory->carStats, 0, sizeof(sharedMemory->carStats));
+	initSessionData(raceNumber, phase, pilotRunning);
 
-	// if in free practice or qualification 1 => all pilots are running, we don't care in which order)
-	if (phase == FREE_PRACTICE_1 || phase == FREE_PRACTICE_2 || phase == FREE_PRACTICE_3
-		|| phase == QUALIFICATION_1 || phase == SPRINT_QUALIFICATION_1) {
-		for (int i=0;i<MAX_PILOT;i++) {
-			sharedMemory->carStats[i].pilotNumber = drivers[i].id;
-			sharedMemory->carStats[i].inStand = true;
-		}
-	} else {
-		// we are in qualification 2/3 or sprint or race, order is important and based on previous result
-		enum RacePhase previousPhase = getPreviousPhase(phase, tracks[raceNumber].sprint);
-		loadPhaseResult(sharedMemory->carStats, raceNumber, previousPhase);
-	}
+	// random numbers of the session: the car simulators derive their own stream from this seed
+	uint64_t sessionSeed = nextSessionSeed();
 
-	// best lap and sections time are set to 999.999
-	for (int i=0;i<MAX_PILOT;i++) {
-		sharedMemory->carTimeAndStatuses[i].carStatus = WAIT_IN_STAND;
-		sharedMemory->carStats[i].bestLap.seconds = 999;
-		sharedMemory->carStats[i].bestLap.milliseconds = 999;
-		for (int j=0;j<3;j++) {
-			sharedMemory->carStats[i].bestSectionTime[j].seconds = 999;
-			sharedMemory->carStats[i].bestSectionTime[j].milliseconds = 999;
+	if (resumeCheckpoint.header) {
+		// same session as the checkpoint: CarStats, running order and race over flag of the controller
+		for (int i = 0; i < pilotCount; i++) {
+			putCarStat(i, &resumeCheckpoint.carStats[i], COLUMN_ALL);
+			sharedMemory->ranking[i] = resumeCheckpoint.ranking[i];
 		}
+		atomic_store_explicit(&sharedMemory->raceOver, resumeCheckpoint.header->raceOver, memory_order_relaxed);
+		sessionSeed = resumeCheckpoint.header->seed;
 	}
 
-	// Mark all carTimeStatus as processed (so car simulator can add new data)
-	for (int i = 0; i < MAX_PILOT; i++) {
-		sharedMemory->carTimeAndStatuses[i].processed = true;
+	// After this point, we will launch multiple process (or threads), so access to shared memory will be done using specific function using semaphores
+	// 1 controller + pilotRunning car simulators + 1 screen manager
+	WorkerArgs workers[pilotRunning+2];
+	pthread_t threads[pilotRunning+2];
+	int workerCount = 0;
+	long long startupStart = getMonotonicNanos();
+	// virtual time 0 of the session, all car simulators schedule their events from this time
+	// (a resumed session continues at the session clock of the checkpoint)
+	sharedMemory->sessionStart = startupStart;
+	if (resumeCheckpoint.header) {
+		sharedMemory->sessionStart -= resumeCheckpoint.header->sessionMillis * 1000000LL / options.speed;
 	}
 
-	// create semaphore
-	//   &sharedMemory->mutex/mutread: will be used between different processus, so located in the shared memory
-	//   1: indicates that the semaphore will be used between processus and not between threads
-	//   1: initial value
-	sem_init(&sharedMemory->mutex, 1, 1);
-	sem_init(&sharedMemory->mutread, 1, 1);
-	sharedMemory->runningCars = pilotRunning;
-
-	// After this point, we will launch multiple process, so access to shared memory will be done using specific function using semaphores
 	// Launch controller
-	pid_t controller_pid = fork();
-	if (controller_pid == 0) {
-		// execute the controller
-		controller(raceNumber, phase, pilotRunning);
-		exit(0);
-	}
+	workers[workerCount].type = CONTROLLER_WORKER;
+	workerCount++;
 
 	// Launch the carSimulator
 	for (int i = 0; i < pilotRunning; i++) {
-		pid_t pid = fork();
-		if (pid == 0) {
-			// delay is used to simulate position on the track when starting a race.  Ignored if free practise or qualification
-			CarTime delay;
-			delay.seconds=i/2;
-			delay.milliseconds=(i*500)%1000;
-			// execute the car simulator
-			carSimulator(i,delay,raceNumber,phase);
-			exit(0);
-		}
+		workers[workerCount].type = CAR_SIMULATOR_WORKER;
+		workers[workerCount].id = i;
+		// delay is used to simulate position on the track when starting a race.  Ignored if free practise or qualification
+		workers[workerCount].delay = i * 500 * CAR_TIME_MILLISECOND;
+		workerCount++;
 	}
 
 	// Launch screenManager
-	pid_t screenManagerPid = fork();
-	if (screenManagerPid == 0) {
-		// execute screenManager
-		screenManager(phase, pilotRunning);
-		exit(0);
+	workers[workerCount].type = SCREEN_MANAGER_WORKER;
+	workerCount++;
+
+	for (int i = 0; i < workerCount; i++) {
+		workers[i].seed = sessionSeed;
+		workers[i].raceNumber = raceNumber;
+		workers[i].phase = phase;
+		workers[i].pilotRunning = pilotRunning;
+		if (!launchWorker(&workers[i], &threads[i])) {
+			// the shared memory is only removed when no worker uses it anymore
+			stopWorkers(workers, threads, i);
+			releaseSharedMemory();
+			exit(1);
+		}
+	}
+	long long startupNanos = getMonotonicNanos() - startupStart;
+
+	// peak memory used by the session (kB)
+	long peakRssKb = 0;
+	if (options.threads) {
+		// Wait until all threads are stopped
+		for (int i = 0; i < workerCount; i++) {
+			pthread_join(threads[i], NULL);
+		}
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		peakRssKb = usage.ru_maxrss;
+	} else {
+		// All childs have the mapping: remove the name now, so nothing is left behind if the program crashes
+		shm_unlink(sharedMemoryName);
+
+		// Wait until all childs are stopped (controller/car simulators/screen manager)
+		// wait4 return the pid of the child and its resource usage: add the peak memory of all processes
+		struct rusage usage;
+		while (wait4(-1, NULL, 0, &usage) > 0) {
+			peakRssKb += usage.ru_maxrss;
+		}
+		getrusage(RUSAGE_SELF, &usage);
+		peakRssKb += usage.ru_maxrss;
 	}
-
-	// Wait until all childs are stopped (controller/car simulators/screen manager)
-	// wait return the pid of the child
-	while (wait(NULL) > 0);
 
 	// After this point, only the main function is running, all child are stopped,
 	// so no need to maange concurrent access to shared memory
-	// save phase result
-	savePhaseResult(raceNumber, phase, pilotRunning);
-
-	// save sprint/race ranking
-	if (phase == RACE || phase == SPRINT) {
-		saveChampionshipResult(raceNumber, phase);
-	}
-
-	// Save championship data
-	file = fopen("championship.txt","w");
-	if (!file) {
-		// error while creating the file
-		perror("Unable to save championship.txt");
-		return 1;
-	} else {
-		// Save data
-		fprintf(file,"race=%d\nphase=%d\n",raceNumber,phase);
-	}
-	fclose(file);
+	// save phase result, sprint/race ranking and championship data
+	saveSessionResult(raceNumber, phase, sessionSeed);
 
 	// display pilot ranking
-	displayRanking(raceNumber);
+	int reportRow = displayRanking(raceNumber);
+
+	// display how the inter process communication behaved
+	displaySessionReport(reportRow+1, pilotRunning, startupNanos, peakRssKb, sessionSeed);
 
 	// Cleanup shared memory
 	cleanupSharedMemory(0);